@@ -0,0 +1,258 @@
+/** atomic_generator.hpp - Lock-free generator for threads and processes */
+
+#ifndef SCRU128_ATOMIC_GENERATOR_HPP
+#define SCRU128_ATOMIC_GENERATOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.hpp"
+#include "generator.hpp"
+#include "probes.h"
+#include "random.hpp"
+
+#ifndef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_16
+#error "16-byte compare-and-swap is unavailable; compile with -mcx16 on x86-64"
+#endif
+
+namespace scru128 {
+
+/** Value of `SharedState::magic` of an initialized state. */
+constexpr uint64_t SHARED_STATE_MAGIC = 0x7363727531323801; // "scru128" v1
+
+/**
+ * Generator state shared by `AtomicGenerator` handles.
+ *
+ * The whole state is packed into a single 128-bit word so that it can be
+ * advanced with one 16-byte compare-and-swap (`cmpxchg16b` on x86-64, `casp`
+ * or `ldxp`/`stxp` on AArch64):
+ *
+ * | Bits     | Field                                               |
+ * | -------- | --------------------------------------------------- |
+ * | 127 - 80 | `timestamp` of the last generated ID                |
+ * | 79 - 56  | `counter_hi` of the last generated ID               |
+ * | 55 - 32  | `counter_lo` of the last generated ID               |
+ * | 31 - 0   | `timestamp` at last `counter_hi` renewal (mod 2^32) |
+ * |          | with bit 0 set, or zero if never renewed            |
+ *
+ * These instructions operate on physical memory and are therefore atomic
+ * across processes that map the same page, which allows the state to live in
+ * a `memfd_create()` or `shm_open()` mapping (see `map_shared_state()`).
+ * Since a handle publishes a new state with a single CAS and holds no lock, a
+ * process that dies at any point leaves behind either the old state or the new
+ * one, never a partial update, and never blocks the surviving processes. A
+ * zero-filled state is a valid initial state.
+ */
+struct alignas(64) SharedState {
+  uint64_t magic;
+  uint64_t reserved;
+  unsigned __int128 word;
+};
+
+/**
+ * Generates monotonically ordered IDs from a `SharedState` shared with other
+ * handles in the same process or in other processes.
+ *
+ * Each thread or process creates its own handle, which holds its own clock
+ * and entropy pool. A handle must not be copied across `fork()`, because the
+ * parent and the child would then draw identical random bytes from the copied
+ * pool; create handles in the worker processes after forking.
+ *
+ * Clock rollbacks and counter overflows are handled as by `Generator`
+ * according to a `GeneratorPolicy`, which all handles of a state should share.
+ * Each handle records in its own `GeneratorStats` the paths taken by the IDs
+ * it has generated; sum them over the handles for the whole state.
+ */
+template <class Clock = RealtimeClock, class Random = SystemRandom>
+class AtomicGenerator {
+ public:
+  explicit AtomicGenerator(SharedState *state, Clock clock = Clock(),
+                           Random random = Random(),
+                           GeneratorPolicy policy = GeneratorPolicy())
+      : state_(state), clock_(clock), pool_(random), policy_(policy) {}
+
+  /**
+   * Generates a new ID.
+   *
+   * @param out 16-byte byte array
+   * @return zero on success or non-zero if the clock has moved back by more
+   * than the rollback allowance and the policy is `RollbackAction::ABORT`
+   */
+  int generate(uint8_t *out) {
+    uint64_t unix_ts_ms = clock_.now_ms() & MAX_TIMESTAMP;
+
+    // read atomically with a CAS that fails unless the state is zero, in
+    // which case it stores the same zero; a 16-byte atomic load would need
+    // libatomic and take a lock there
+    unsigned __int128 *word = &state_->word;
+    unsigned __int128 expected = __sync_val_compare_and_swap(word, 0, 0);
+    for (;;) {
+      Transition transition;
+      unsigned __int128 desired =
+          next_state(expected, unix_ts_ms, &transition);
+      if (transition.abort) {
+        SCRU128_PROBE2(clock_abort, (uint64_t)(expected >> 80), unix_ts_ms);
+        GeneratorStats::increment(stats_.aborts);
+        return -1;
+      }
+      unsigned __int128 actual =
+          __sync_val_compare_and_swap(word, expected, desired);
+      if (actual == expected) {
+        record(transition, (uint64_t)(desired >> 80), unix_ts_ms);
+        store_id(out, (uint64_t)(desired >> 80),
+                 (uint32_t)(desired >> 56) & MAX_COUNTER_HI,
+                 (uint32_t)(desired >> 32) & MAX_COUNTER_LO, pool_.next_u32());
+        return 0;
+      }
+      SCRU128_PROBE0(cas_retry);
+      expected = actual;
+    }
+  }
+
+  /** Returns the policy of this handle. */
+  const GeneratorPolicy &policy() const { return policy_; }
+
+  /** Returns a snapshot of the counters of the IDs of this handle. */
+  GeneratorStats stats() const { return stats_.snapshot(); }
+
+ private:
+  /** Paths taken by `next_state()`, recorded only once the CAS succeeds. */
+  struct Transition {
+    bool tolerated_rollback = false;
+    bool counter_overflow = false;
+    bool reset = false;
+    bool abort = false;
+  };
+
+  /**
+   * Computes the state for a new ID as `Generator` does, except that the
+   * timestamp at last renewal of `counter_hi` is kept modulo 2^32 with the
+   * lowest bit set, so that it never equals the zero that forces a renewal
+   * even in a millisecond that is a multiple of 2^32.
+   */
+  unsigned __int128 next_state(unsigned __int128 state, uint64_t unix_ts_ms,
+                               Transition *transition) {
+    uint64_t timestamp = (uint64_t)(state >> 80);
+    uint32_t counter_hi = (uint32_t)(state >> 56) & MAX_COUNTER_HI;
+    uint32_t counter_lo = (uint32_t)(state >> 32) & MAX_COUNTER_LO;
+    uint32_t ts_counter_hi = (uint32_t)state;
+
+    if (unix_ts_ms > timestamp) {
+      timestamp = unix_ts_ms;
+      counter_lo = pool_.next_u24();
+    } else if (unix_ts_ms + policy_.rollback_allowance >= timestamp) {
+      // go on with previous timestamp if new one is not much smaller
+      if (unix_ts_ms < timestamp) {
+        SCRU128_PROBE2(clock_rollback, timestamp, unix_ts_ms);
+        transition->tolerated_rollback = true;
+      }
+      counter_lo++;
+      if (counter_lo > MAX_COUNTER_LO) {
+        counter_lo = 0;
+        counter_hi++;
+        if (counter_hi > MAX_COUNTER_HI) {
+          counter_hi = 0;
+          // increment timestamp at counter overflow
+          timestamp++;
+          SCRU128_PROBE1(counter_overflow, timestamp);
+          counter_lo = pool_.next_u24();
+          transition->counter_overflow = true;
+        }
+      }
+    } else if (policy_.on_large_rollback == RollbackAction::ABORT) {
+      transition->abort = true;
+      return state;
+    } else {
+      // reset state if clock moves back by more than allowance
+      SCRU128_PROBE2(clock_reset, timestamp, unix_ts_ms);
+      transition->reset = true;
+      timestamp = unix_ts_ms;
+      ts_counter_hi = 0;
+      counter_lo = pool_.next_u24();
+    }
+
+    uint32_t ts_now = (uint32_t)timestamp | 1;
+    if (ts_now - ts_counter_hi >= 1000 || ts_counter_hi == 0) {
+      // renew counter_hi every second
+      ts_counter_hi = ts_now;
+      counter_hi = pool_.next_u24();
+    }
+
+    return (unsigned __int128)timestamp << 80 |
+           (unsigned __int128)counter_hi << 56 |
+           (unsigned __int128)counter_lo << 32 | ts_counter_hi;
+  }
+
+  /** Records the paths taken by an ID published with `timestamp`. */
+  void record(const Transition &transition, uint64_t timestamp,
+              uint64_t unix_ts_ms) {
+    if (transition.tolerated_rollback) {
+      GeneratorStats::increment(stats_.tolerated_rollbacks);
+    }
+    if (transition.counter_overflow) {
+      GeneratorStats::increment(stats_.counter_overflows);
+    }
+    if (transition.reset) {
+      GeneratorStats::increment(stats_.resets);
+    }
+    stats_.record_lead(timestamp, unix_ts_ms);
+  }
+
+  SharedState *state_;
+  Clock clock_;
+  EntropyPool<Random> pool_;
+  GeneratorPolicy policy_;
+  GeneratorStats stats_;
+};
+
+/**
+ * Maps a `SharedState` from a file descriptor obtained by `memfd_create()` or
+ * `shm_open()`, extending the file if it is empty.
+ *
+ * Processes that map the same file share the state. A freshly created file is
+ * zero-filled and is initialized by whichever process maps it first.
+ *
+ * @param fd file descriptor opened for reading and writing
+ * @return pointer to the shared state, or `nullptr` on failure or if the file
+ * holds something other than a `SharedState`
+ */
+inline SharedState *map_shared_state(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return nullptr;
+  }
+  if (st.st_size == 0 && ftruncate(fd, sizeof(SharedState)) != 0) {
+    return nullptr;
+  }
+  if (st.st_size != 0 && st.st_size < (off_t)sizeof(SharedState)) {
+    return nullptr;
+  }
+
+  void *addr = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+
+  SharedState *state = (SharedState *)addr;
+  uint64_t magic = 0;
+  __atomic_compare_exchange_n(&state->magic, &magic, SHARED_STATE_MAGIC, false,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  if (magic != 0 && magic != SHARED_STATE_MAGIC) {
+    munmap(addr, sizeof(SharedState));
+    return nullptr;
+  }
+  return state;
+}
+
+/** Unmaps a `SharedState` mapped by `map_shared_state()`. */
+inline void unmap_shared_state(SharedState *state) {
+  munmap(state, sizeof(SharedState));
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_ATOMIC_GENERATOR_HPP */
@@ -0,0 +1,326 @@
+/** atomic_generator_test.cpp - Tests for atomic_generator.hpp
+ *
+ * Build with `-mcx16 -pthread` on x86-64.
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <mutex>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "atomic_generator.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+struct Id16 {
+  uint8_t bytes[16];
+  bool operator<(const Id16 &other) const {
+    return memcmp(bytes, other.bytes, 16) < 0;
+  }
+};
+
+/** Returns the upper 96 bits, which must be unique across all handles. */
+static unsigned __int128 counters_of(const Id16 &id) {
+  unsigned __int128 value = 0;
+  for (int i = 0; i < 12; i++) {
+    value = value << 8 | id.bytes[i];
+  }
+  return value;
+}
+
+static int create_state_fd(void) {
+  int fd = memfd_create("scru128-test", 0);
+  assert(fd >= 0);
+  return fd;
+}
+
+/** Generates unique, per-thread monotonic IDs from multiple threads. */
+static void test_threads(void) {
+  const int N_THREADS = 4;
+  const int N_IDS = 50000;
+  static SharedState state;
+  std::vector<Id16> ids(N_THREADS * N_IDS);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < N_THREADS; t++) {
+    threads.emplace_back([&, t] {
+      AtomicGenerator<> g(&state);
+      for (int i = 0; i < N_IDS; i++) {
+        g.generate(ids[t * N_IDS + i].bytes);
+      }
+    });
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+
+  for (int t = 0; t < N_THREADS; t++) {
+    for (int i = 1; i < N_IDS; i++) {
+      assert(ids[t * N_IDS + i - 1] < ids[t * N_IDS + i]);
+    }
+  }
+  std::vector<unsigned __int128> counters;
+  for (const Id16 &id : ids) {
+    counters.push_back(counters_of(id));
+  }
+  std::sort(counters.begin(), counters.end());
+  assert(std::adjacent_find(counters.begin(), counters.end()) ==
+         counters.end());
+}
+
+/** Applies the rollback policy and counts the paths taken per handle. */
+static void test_policy(void) {
+  SharedState state = {};
+  VirtualClock clock(T);
+  GeneratorPolicy policy;
+  policy.rollback_allowance = 100;
+  policy.on_large_rollback = RollbackAction::ABORT;
+  typedef AtomicGenerator<ClockRef<VirtualClock>> Handle;
+  Handle a(&state, ClockRef<VirtualClock>(&clock), SystemRandom(), policy);
+  Handle b(&state, ClockRef<VirtualClock>(&clock), SystemRandom(), policy);
+  Id16 prev, curr;
+
+  assert(a.generate(prev.bytes) == 0);
+  clock.rewind(100);
+  assert(b.generate(curr.bytes) == 0);
+  assert(prev < curr);
+  assert(b.stats().tolerated_rollbacks == 1);
+  assert(b.stats().timestamp_lead_ms == 100);
+  assert(a.stats().tolerated_rollbacks == 0);
+
+  clock.rewind(1);
+  assert(a.generate(curr.bytes) != 0);
+  assert(b.generate(curr.bytes) != 0);
+  assert(a.stats().aborts == 1 && b.stats().aborts == 1);
+
+  policy.on_large_rollback = RollbackAction::RESET;
+  Handle c(&state, ClockRef<VirtualClock>(&clock), SystemRandom(), policy);
+  assert(c.generate(curr.bytes) == 0);
+  assert(c.stats().resets == 1 && c.stats().timestamp_lead_ms == 0);
+}
+
+/** Keeps counter_hi within a millisecond whose low 32 bits are zero. */
+static void test_timestamp_wrap(void) {
+  SharedState state = {};
+  VirtualClock clock((uint64_t)0x100 << 32, 1000);
+  AtomicGenerator<ClockRef<VirtualClock>> g(&state,
+                                            ClockRef<VirtualClock>(&clock));
+  Id16 prev, curr;
+  assert(g.generate(prev.bytes) == 0);
+  for (int i = 0; i < 3000; i++) {
+    assert(g.generate(curr.bytes) == 0);
+    assert(prev < curr);
+    prev = curr;
+  }
+}
+
+/** Generates unique, per-process monotonic IDs from forked processes. */
+static void test_processes(void) {
+  const int N_PROCS = 4;
+  const int N_IDS = 20000;
+  int fd = create_state_fd();
+  SharedState *state = map_shared_state(fd);
+  assert(state != nullptr);
+
+  size_t out_size = sizeof(Id16) * N_PROCS * N_IDS;
+  Id16 *ids = (Id16 *)mmap(nullptr, out_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(ids != MAP_FAILED);
+
+  for (int p = 0; p < N_PROCS; p++) {
+    if (fork() == 0) {
+      SharedState *child_state = map_shared_state(fd);
+      AtomicGenerator<> g(child_state);
+      for (int i = 0; i < N_IDS; i++) {
+        g.generate(ids[p * N_IDS + i].bytes);
+      }
+      _exit(0);
+    }
+  }
+  for (int p = 0; p < N_PROCS; p++) {
+    int status;
+    wait(&status);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  for (int p = 0; p < N_PROCS; p++) {
+    for (int i = 1; i < N_IDS; i++) {
+      assert(ids[p * N_IDS + i - 1] < ids[p * N_IDS + i]);
+    }
+  }
+  std::vector<unsigned __int128> counters;
+  for (int i = 0; i < N_PROCS * N_IDS; i++) {
+    counters.push_back(counters_of(ids[i]));
+  }
+  std::sort(counters.begin(), counters.end());
+  assert(std::adjacent_find(counters.begin(), counters.end()) ==
+         counters.end());
+
+  munmap(ids, out_size);
+  unmap_shared_state(state);
+  close(fd);
+}
+
+/** Continues in monotonic order after a worker is killed mid-generation. */
+static void test_killed_worker(void) {
+  int fd = create_state_fd();
+  SharedState *state = map_shared_state(fd);
+  assert(state != nullptr);
+
+  Id16 *last = (Id16 *)mmap(nullptr, sizeof(Id16), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  assert(last != MAP_FAILED);
+  memset(last, 0, sizeof(Id16));
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    AtomicGenerator<> g(state);
+    for (;;) {
+      Id16 id;
+      g.generate(id.bytes);
+      *last = id;
+    }
+  }
+  struct timespec delay = {0, 20000000};
+  nanosleep(&delay, NULL);
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+
+  Id16 child_last = *last;
+  assert(counters_of(child_last) != 0);
+  AtomicGenerator<> g(state);
+  Id16 prev = child_last, curr;
+  for (int i = 0; i < 1000; i++) {
+    g.generate(curr.bytes);
+    assert(prev < curr);
+    prev = curr;
+  }
+
+  munmap(last, sizeof(Id16));
+  unmap_shared_state(state);
+  close(fd);
+}
+
+/** Rejects a file that holds something other than a shared state. */
+static void test_foreign_file(void) {
+  int fd = create_state_fd();
+  char junk[sizeof(SharedState)];
+  memset(junk, 'x', sizeof(junk));
+  assert(write(fd, junk, sizeof(junk)) == (ssize_t)sizeof(junk));
+  assert(map_shared_state(fd) == nullptr);
+  close(fd);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Measures throughput of 1-32 processes sharing one state. */
+static void bench_processes(void) {
+  const int N_IDS = 1000000;
+  for (int n_procs = 1; n_procs <= 32; n_procs *= 2) {
+    int fd = create_state_fd();
+    SharedState *state = map_shared_state(fd);
+
+    uint64_t start = now_ns();
+    for (int p = 0; p < n_procs; p++) {
+      if (fork() == 0) {
+        AtomicGenerator<> g(state);
+        uint8_t id[16];
+        for (int i = 0; i < N_IDS; i++) {
+          g.generate(id);
+        }
+        _exit(id[15] == 0xff);
+      }
+    }
+    for (int p = 0; p < n_procs; p++) {
+      wait(NULL);
+    }
+    double elapsed = (double)(now_ns() - start);
+
+    printf("%2d processes: %7.2f ns/id per process  %7.2f M ids/s total\n",
+           n_procs, elapsed / N_IDS, n_procs * N_IDS / elapsed * 1e3);
+    unmap_shared_state(state);
+    close(fd);
+  }
+}
+
+/**
+ * Compares per-ID cost of stateless generators owned by each thread with that
+ * of stateful generators shared by all threads.
+ */
+static void bench_stateless_vs_stateful(void) {
+  const int N_IDS = 1000000;
+  for (int n_threads = 1; n_threads <= 64; n_threads *= 4) {
+    auto run = [&](auto &&body) {
+      std::vector<std::thread> threads;
+      uint64_t start = now_ns();
+      for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back(body);
+      }
+      for (auto &th : threads) {
+        th.join();
+      }
+      return (double)(now_ns() - start) / ((double)N_IDS * n_threads);
+    };
+
+    double stateless_ns = run([&] {
+      StatelessGenerator<> g;
+      uint8_t id[16];
+      for (int i = 0; i < N_IDS; i++) {
+        g.generate(id);
+      }
+    });
+
+    SharedState state = {};
+    double atomic_ns = run([&] {
+      AtomicGenerator<> g(&state);
+      uint8_t id[16];
+      for (int i = 0; i < N_IDS; i++) {
+        g.generate(id);
+      }
+    });
+
+    Generator<> shared;
+    std::mutex mutex;
+    double mutex_ns = run([&] {
+      uint8_t id[16];
+      for (int i = 0; i < N_IDS; i++) {
+        std::lock_guard<std::mutex> lock(mutex);
+        shared.generate(id);
+      }
+    });
+
+    printf("%2d threads: stateless %7.2f  shared atomic %7.2f  "
+           "shared mutex %7.2f ns/id (wall time / total ids)\n",
+           n_threads, stateless_ns, atomic_ns, mutex_ns);
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_threads();
+  test_policy();
+  test_timestamp_wrap();
+  test_processes();
+  test_killed_worker();
+  test_foreign_file();
+#ifdef RUN_BENCHMARKS
+  bench_processes();
+  bench_stateless_vs_stateful();
+#endif
+  return 0;
+}
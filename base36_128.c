@@ -3,6 +3,16 @@
 #include <assert.h>
 #include <stdint.h>
 
+#ifdef USE_SDT_PROBES
+#include "probes.h"
+#endif
+
+/* no-op probes that keep this file standalone unless probes.h is included */
+#ifndef SCRU128_PROBE0
+#define SCRU128_PROBE0(name) ((void)0)
+#define SCRU128_PROBE1(name, a) ((void)0)
+#endif
+
 /**
  * Converts a digit value array in `in_base` into that in `out_base`.
  *
@@ -139,23 +149,27 @@ int decode(const char *text, uint8_t *out) {
   for (int i = 0; i < 25; i++) {
     unsigned char code = text[i];
     if (code > 127 || DECODE_MAP[code] == 0xff) {
+      SCRU128_PROBE1(decode_invalid_digit, i);
       return -1; // invalid digit character
     }
     digit_values[i] = DECODE_MAP[code];
   }
   if (text[25] != '\0') {
+    SCRU128_PROBE0(decode_invalid_length);
     return -1; // invalid length
   }
 
   // convert digit value array into byte array
   int err = convert_base(digit_values, 25, 36, out, 16, 256);
   if (err != 0) {
+    SCRU128_PROBE0(decode_out_of_range);
     return -1; // out of 128-bit value range
   }
 
   return 0; // success
 }
 
+#ifndef BASE36_128_NO_MAIN
 /** Executes the implementation against prepared test cases. */
 static void test_positive_cases(void) {
   struct TestCase {
@@ -219,3 +233,4 @@ int main(void) {
   test_negative_cases();
   return 0;
 }
+#endif /* #ifndef BASE36_128_NO_MAIN */
@@ -0,0 +1,367 @@
+/** checker.hpp - Conformance checker for generator output */
+
+#ifndef SCRU128_CHECKER_HPP
+#define SCRU128_CHECKER_HPP
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clock.hpp"
+#include "codec.hpp"
+#include "generator.hpp"
+
+namespace scru128 {
+
+/** Options of `Checker`. */
+struct CheckerOptions {
+  /**
+   * Time in milliseconds around which every `timestamp` must lie, or zero to
+   * use the current time at the construction of the checker.
+   */
+  uint64_t reference_ms = 0;
+
+  /** Maximum distance in milliseconds between `timestamp` and reference. */
+  uint64_t tolerance_ms = DEFAULT_ROLLBACK_ALLOWANCE;
+
+  /**
+   * Maximum absolute z-score of the number of one bits at each position of
+   * the `entropy` field. The default makes a false alarm on truly random
+   * input practically impossible (about 2e-8 per run across the 32 bits).
+   */
+  double max_entropy_z = 6.0;
+};
+
+/** Counts of records and of violations found by `Checker`. */
+struct CheckReport {
+  /** Number of records checked, including invalid ones. */
+  uint64_t records = 0;
+
+  /** Number of records that could not be decoded. */
+  uint64_t invalid = 0;
+
+  /** Number of IDs not greater than the preceding valid ID. */
+  uint64_t out_of_order = 0;
+
+  /** Number of IDs whose `timestamp` is too far from the reference time. */
+  uint64_t timestamp_out_of_range = 0;
+
+  /**
+   * Number of IDs that share `timestamp` with the preceding ID but whose
+   * `counter_lo` is not the preceding one plus one.
+   */
+  uint64_t counter_lo_errors = 0;
+
+  /** Number of IDs whose `timestamp` differs from that of the preceding ID. */
+  uint64_t new_timestamps = 0;
+
+  /**
+   * Number of IDs counted in `new_timestamps` whose `counter_lo` is not a
+   * fresh random number but the preceding one plus one or zero.
+   */
+  uint64_t stale_counters = 0;
+
+  /**
+   * Number of `stale_counters` that fresh random numbers may hit by chance,
+   * with the same margin as `max_entropy_z`.
+   */
+  uint64_t max_stale_counters = 0;
+
+  /** Number of renewals of `counter_hi` (other than carries) observed. */
+  uint64_t counter_hi_renewals = 0;
+
+  /** Number of renewals of `counter_hi` less than a second apart. */
+  uint64_t early_renewals = 0;
+
+  /** Number of IDs that keep `counter_hi` a second or more after renewal. */
+  uint64_t missed_renewals = 0;
+
+  /** Maximum absolute z-score of bit balance across the `entropy` field. */
+  double max_entropy_z = 0.0;
+
+  /** Number of `entropy` bits whose z-score exceeds the limit. */
+  uint64_t unbalanced_bits = 0;
+
+  /** Returns true if no violation has been found. */
+  bool passed() const {
+    return invalid == 0 && out_of_order == 0 && timestamp_out_of_range == 0 &&
+           counter_lo_errors == 0 && stale_counters <= max_stale_counters &&
+           early_renewals == 0 && missed_renewals == 0 && unbalanced_bits == 0;
+  }
+};
+
+/**
+ * Validates a stream of IDs produced by a single generator against the rules
+ * of the specification, in the spirit of the SCRU128 Generator Tester.
+ *
+ * For each ID, the checker verifies that it decodes, that it is greater than
+ * the preceding ID, and that its `timestamp` is within `tolerance_ms` of the
+ * reference time. Within a `timestamp`, `counter_lo` must increase by one,
+ * carrying into `counter_hi`, and a new `timestamp` must start from a fresh
+ * random `counter_lo`, which is checked as far as a single value can be: one
+ * that continues the preceding `counter_lo` or restarts at zero is stale, and
+ * more stale counters than random numbers would produce by chance (about two
+ * in 2^24) are a violation. `counter_hi` may otherwise change only when it
+ * is renewed, which must happen once a second: a renewal less than 1000
+ * milliseconds after the previous one, or an ID that keeps `counter_hi` 1000
+ * milliseconds or more after the last renewal, is counted as a violation.
+ * The renewal checks start at the first renewal observed, as the time of the
+ * renewal before the stream is unknown.
+ *
+ * The checker also counts one bits at each of the 128 bit positions. IDs are
+ * counted in blocks of up to 255, which is the capacity of 8-bit counters: a
+ * block is summed up in eight 16-lane vectors of 8-bit counters (one vector
+ * per bit index within a byte, one lane per byte position) held in registers,
+ * so that each ID costs eight vector mask-compare-subtract sequences without
+ * any shift (x86 has no 8-bit vector shift), and the lanes
+ * are then added to 64-bit totals. `feed_binary()` counts its input in place,
+ * while IDs checked one by one are staged in a block buffer first. Only the
+ * `entropy` field is expected to be balanced and is checked; the other
+ * positions are available through `bit_z_score()`.
+ *
+ * Text records are 25 digits followed by `\n` (optionally preceded by `\r`);
+ * binary records are 16-byte big-endian IDs.
+ */
+class Checker {
+ public:
+  explicit Checker(CheckerOptions options = CheckerOptions())
+      : options_(options) {
+    if (options_.reference_ms == 0) {
+      options_.reference_ms = RealtimeClock().now_ms();
+    }
+  }
+
+  /** Checks a single ID given as two native 64-bit words. */
+  void check_words(uint64_t hi, uint64_t lo) {
+    uint8_t *id = staged_ + 16 * n_staged_;
+    for (int i = 0; i < 8; i++) {
+      id[i] = (uint8_t)(hi >> (56 - 8 * i));
+      id[i + 8] = (uint8_t)(lo >> (56 - 8 * i));
+    }
+    if (++n_staged_ == BLOCK_SIZE) {
+      flush_staged();
+    }
+    check_fields(hi, lo);
+  }
+
+  /** Checks a single 16-byte binary ID. */
+  void check_binary(const uint8_t *id) {
+    uint64_t hi = 0, lo = 0;
+    for (int i = 0; i < 8; i++) {
+      hi = hi << 8 | id[i];
+      lo = lo << 8 | id[i + 8];
+    }
+    check_words(hi, lo);
+  }
+
+  /**
+   * Checks a single text record without its line terminator.
+   *
+   * @param record record text
+   * @param len length of `record`, which must be 25 (or 26 with trailing
+   * `\r`) for a valid record
+   */
+  void check_text(const char *record, size_t len) {
+    uint64_t hi, lo;
+    if (len > 0 && record[len - 1] == '\r') {
+      len--;
+    }
+    if (len != 25 || decode_words(record, &hi, &lo) != 0) {
+      report_.records++;
+      report_.invalid++;
+      return;
+    }
+    check_words(hi, lo);
+  }
+
+  /**
+   * Checks the complete lines in `buf`.
+   *
+   * @param buf text data
+   * @param len length of `buf`
+   * @return number of bytes consumed; the remainder is an incomplete line that
+   * should be passed again with the subsequent data, or to `check_text()` at
+   * the end of the stream
+   */
+  size_t feed_text(const char *buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+      // fast path for well-formed 26-byte records
+      if (len - pos >= 26 && buf[pos + 25] == '\n') {
+        check_text(buf + pos, 25);
+        pos += 26;
+        continue;
+      }
+      const char *eol = (const char *)memchr(buf + pos, '\n', len - pos);
+      if (eol == nullptr) {
+        break;
+      }
+      check_text(buf + pos, (size_t)(eol - (buf + pos)));
+      pos = (size_t)(eol - buf) + 1;
+    }
+    return pos;
+  }
+
+  /** Checks `n` consecutive 16-byte binary IDs. */
+  void feed_binary(const uint8_t *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      uint64_t hi = 0, lo = 0;
+      for (int j = 0; j < 8; j++) {
+        hi = hi << 8 | buf[16 * i + j];
+        lo = lo << 8 | buf[16 * i + j + 8];
+      }
+      check_fields(hi, lo);
+    }
+    for (size_t i = 0; i < n; i += BLOCK_SIZE) {
+      count_bits(buf + 16 * i, n - i < BLOCK_SIZE ? n - i : BLOCK_SIZE);
+    }
+  }
+
+  /**
+   * Returns the z-score of the number of one bits at bit position `bit`, where
+   * zero is the most significant bit.
+   */
+  double bit_z_score(int bit) {
+    flush_staged();
+    uint64_t n = report_.records - report_.invalid;
+    if (n == 0) {
+      return 0.0;
+    }
+    return ((double)ones_[bit] - (double)n / 2) / sqrt((double)n / 4);
+  }
+
+  /** Returns the results so far. */
+  const CheckReport &report() {
+    report_.max_entropy_z = 0.0;
+    report_.unbalanced_bits = 0;
+    for (int bit = 96; bit < 128; bit++) {
+      double z = fabs(bit_z_score(bit));
+      if (z > report_.max_entropy_z) {
+        report_.max_entropy_z = z;
+      }
+      report_.unbalanced_bits += z > options_.max_entropy_z;
+    }
+    // a fresh counter_lo is stale with probability 2 / 2^24
+    double expected = (double)report_.new_timestamps * 2.0 / 16777216.0;
+    report_.max_stale_counters =
+        (uint64_t)(expected + options_.max_entropy_z * (sqrt(expected) + 1.0));
+    return report_;
+  }
+
+  /** Returns the options in effect, with the reference time resolved. */
+  const CheckerOptions &options() const { return options_; }
+
+ private:
+  typedef uint8_t Bytes __attribute__((vector_size(16)));
+
+  /** Maximum number of IDs whose bits fit in 8-bit counters. */
+  static constexpr size_t BLOCK_SIZE = 255;
+
+  void check_fields(uint64_t hi, uint64_t lo) {
+    report_.records++;
+
+    uint64_t timestamp = hi >> 16;
+    uint32_t counter_hi = (uint32_t)(hi << 8 & MAX_COUNTER_HI) |
+                          (uint32_t)(lo >> 56);
+    uint32_t counter_lo = (uint32_t)(lo >> 32) & MAX_COUNTER_LO;
+
+    uint64_t distance = timestamp > options_.reference_ms
+                            ? timestamp - options_.reference_ms
+                            : options_.reference_ms - timestamp;
+    report_.timestamp_out_of_range += distance > options_.tolerance_ms;
+
+    if (has_prev_) {
+      if (hi < prev_hi_ || (hi == prev_hi_ && lo <= prev_lo_)) {
+        report_.out_of_order++;
+      }
+      check_counters(timestamp, counter_hi, counter_lo);
+    }
+    has_prev_ = true;
+    prev_hi_ = hi;
+    prev_lo_ = lo;
+    prev_timestamp_ = timestamp;
+    prev_counter_hi_ = counter_hi;
+    prev_counter_lo_ = counter_lo;
+  }
+
+  void check_counters(uint64_t timestamp, uint32_t counter_hi,
+                      uint32_t counter_lo) {
+    bool carried = false;
+    if (timestamp == prev_timestamp_) {
+      if (counter_lo != ((prev_counter_lo_ + 1) & MAX_COUNTER_LO)) {
+        report_.counter_lo_errors++;
+      }
+      carried = counter_lo == 0 &&
+                counter_hi == ((prev_counter_hi_ + 1) & MAX_COUNTER_HI);
+    } else {
+      report_.new_timestamps++;
+      report_.stale_counters +=
+          counter_lo == ((prev_counter_lo_ + 1) & MAX_COUNTER_LO) ||
+          counter_lo == 0;
+      // counter overflow increments timestamp and zeroes counter_hi
+      carried = timestamp == prev_timestamp_ + 1 && counter_hi == 0 &&
+                prev_counter_hi_ == MAX_COUNTER_HI &&
+                prev_counter_lo_ == MAX_COUNTER_LO;
+    }
+
+    if (counter_hi != prev_counter_hi_ && !carried) {
+      report_.counter_hi_renewals++;
+      if (has_renewal_ && timestamp - ts_renewal_ < 1000) {
+        report_.early_renewals++;
+      }
+      has_renewal_ = true;
+      ts_renewal_ = timestamp;
+    } else if (has_renewal_ && timestamp - ts_renewal_ >= 1000 &&
+               timestamp > ts_renewal_) {
+      report_.missed_renewals++;
+    }
+  }
+
+  /** Adds the one bits of `n` IDs, where `n` <= `BLOCK_SIZE`. */
+  void count_bits(const uint8_t *ids, size_t n) {
+    static constexpr uint8_t BITS[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    Bytes counts[8] = {};
+    for (size_t i = 0; i < n; i++) {
+      Bytes v;
+      memcpy(&v, ids + 16 * i, 16);
+      // lanes of (v & mask) == mask are all-one bits, i.e., minus one
+#pragma GCC unroll 8
+      for (int b = 0; b < 8; b++) {
+        Bytes mask = Bytes{} + BITS[b];
+        counts[b] -= (Bytes)((v & mask) == mask);
+      }
+    }
+    for (int b = 0; b < 8; b++) {
+      for (int i = 0; i < 16; i++) {
+        ones_[8 * i + 7 - b] += counts[b][i];
+      }
+    }
+  }
+
+  void flush_staged() {
+    count_bits(staged_, n_staged_);
+    n_staged_ = 0;
+  }
+
+  CheckerOptions options_;
+  CheckReport report_;
+
+  bool has_prev_ = false;
+  uint64_t prev_hi_ = 0;
+  uint64_t prev_lo_ = 0;
+  uint64_t prev_timestamp_ = 0;
+  uint32_t prev_counter_hi_ = 0;
+  uint32_t prev_counter_lo_ = 0;
+
+  bool has_renewal_ = false;
+  uint64_t ts_renewal_ = 0; // timestamp at last renewal of counter_hi
+
+  uint64_t ones_[128] = {}; // one bits per bit position
+  uint8_t staged_[16 * BLOCK_SIZE];
+  size_t n_staged_ = 0;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_CHECKER_HPP */
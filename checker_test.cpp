@@ -0,0 +1,229 @@
+/** checker_test.cpp - Tests for checker.hpp */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "checker.hpp"
+#include "clock.hpp"
+#include "codec.hpp"
+#include "generator.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+static CheckerOptions options_at(uint64_t reference_ms, uint64_t tolerance) {
+  CheckerOptions options;
+  options.reference_ms = reference_ms;
+  options.tolerance_ms = tolerance;
+  return options;
+}
+
+/** Encodes a 16-byte ID as a 26-byte text record. */
+static void append_record(std::vector<char> &text, const uint8_t *id) {
+  char record[26];
+  encode(id, record);
+  record[25] = '\n';
+  text.insert(text.end(), record, record + 26);
+}
+
+/** Accepts the output of the generator fed in arbitrary chunks. */
+static void test_generator_output(void) {
+  const size_t N = 200000;
+  Generator<> g;
+  std::vector<char> text(26 * N);
+  assert(g.generate_text(N, text.data(), text.size()) == 26 * N);
+
+  Checker checker;
+  size_t pos = 0, chunk = 1;
+  while (pos < text.size()) {
+    size_t end = pos + chunk < text.size() ? pos + chunk : text.size();
+    pos += checker.feed_text(text.data() + pos, end - pos);
+    chunk = chunk * 3 + 7;
+    if (end == text.size() && pos < end) {
+      checker.check_text(text.data() + pos, end - pos);
+      pos = end;
+    }
+  }
+  const CheckReport &report = checker.report();
+  assert(report.records == N);
+  assert(report.passed());
+}
+
+/** Tracks `counter_hi` renewals over several seconds of virtual time. */
+static void test_renewals(void) {
+  const size_t N = 100000;
+  DeterministicGenerator g(VirtualClock(T, 10), WyrandRandom(42));
+  std::vector<uint8_t> ids(16 * N);
+  for (size_t i = 0; i < N; i++) {
+    g.generate(ids.data() + 16 * i);
+  }
+
+  Checker checker(options_at(T, 20000));
+  checker.feed_binary(ids.data(), N);
+  const CheckReport &report = checker.report();
+  assert(report.records == N);
+  assert(report.counter_hi_renewals >= 9);
+  assert(report.passed());
+
+  // a binary stream and its textual form yield the same results
+  std::vector<char> text;
+  for (size_t i = 0; i < N; i++) {
+    append_record(text, ids.data() + 16 * i);
+  }
+  Checker text_checker(options_at(T, 20000));
+  assert(text_checker.feed_text(text.data(), text.size()) == text.size());
+  assert(text_checker.report().counter_hi_renewals ==
+         report.counter_hi_renewals);
+  assert(text_checker.report().passed());
+}
+
+/** Accepts carries from counter overflows but rejects constant `entropy`. */
+static void test_counter_overflow(void) {
+  Generator<FixedClock, MaxRandom> g;
+  g.clock().now = T;
+  uint8_t ids[16 * 100];
+  for (int i = 0; i < 100; i++) {
+    g.generate(ids + 16 * i);
+  }
+
+  Checker checker(options_at(T, 10));
+  checker.feed_binary(ids, 100);
+  const CheckReport &report = checker.report();
+  assert(report.out_of_order == 0);
+  assert(report.counter_lo_errors == 0);
+  assert(report.counter_hi_renewals == 0);
+  assert(report.unbalanced_bits == 32);
+  assert(!report.passed());
+}
+
+/** Detects each kind of injected fault. */
+static void test_injected_faults(void) {
+  uint8_t id[16];
+
+  // undecodable records, including CRLF-terminated valid ones
+  {
+    Checker checker(options_at(T, 10));
+    std::vector<char> text;
+    store_id(id, T, 1, 100, 0);
+    append_record(text, id);
+    text.back() = '\r';
+    text.push_back('\n');
+    const char *bad = "0372hg16csmsm50l8dikcvuk+\n"
+                      "0372hg16\n"
+                      "zzzzzzzzzzzzzzzzzzzzzzzzz\n";
+    text.insert(text.end(), bad, bad + strlen(bad));
+    assert(checker.feed_text(text.data(), text.size()) == text.size());
+    assert(checker.report().records == 4);
+    assert(checker.report().invalid == 3);
+  }
+
+  // swapped records
+  {
+    Checker checker(options_at(T, 10));
+    store_id(id, T, 1, 101, 0);
+    checker.check_binary(id);
+    store_id(id, T, 1, 100, 0);
+    checker.check_binary(id);
+    assert(checker.report().out_of_order == 1);
+    assert(checker.report().counter_lo_errors == 1);
+  }
+
+  // skipped counter_lo and stale timestamp
+  {
+    Checker checker(options_at(T, 10));
+    store_id(id, T, 1, 100, 0);
+    checker.check_binary(id);
+    store_id(id, T, 1, 102, 0);
+    checker.check_binary(id);
+    store_id(id, T + 11, 1, 5, 0);
+    checker.check_binary(id);
+    assert(checker.report().out_of_order == 0);
+    assert(checker.report().counter_lo_errors == 1);
+    assert(checker.report().timestamp_out_of_range == 1);
+  }
+
+  // early and missed renewals of counter_hi
+  {
+    Checker checker(options_at(T, 5000));
+    store_id(id, T, 1, 100, 0);
+    checker.check_binary(id);
+    store_id(id, T + 1, 2, 100, 0); // first renewal observed
+    checker.check_binary(id);
+    store_id(id, T + 999, 3, 100, 0); // early
+    checker.check_binary(id);
+    store_id(id, T + 1999, 4, 100, 0); // on time
+    checker.check_binary(id);
+    store_id(id, T + 2999, 4, 100, 0); // missed
+    checker.check_binary(id);
+    const CheckReport &report = checker.report();
+    assert(report.counter_hi_renewals == 3);
+    assert(report.early_renewals == 1);
+    assert(report.missed_renewals == 1);
+    assert(report.counter_lo_errors == 0);
+  }
+
+  // counter_lo carried on or reset to zero at each new timestamp
+  for (bool reset : {false, true}) {
+    Checker checker(options_at(T, 100));
+    for (uint32_t i = 0; i < 40; i++) {
+      store_id(id, T + i / 2, 1, reset ? i % 2 : 100 + i, 0);
+      checker.check_binary(id);
+    }
+    const CheckReport &report = checker.report();
+    assert(report.counter_lo_errors == 0);
+    assert(report.new_timestamps == 19 && report.stale_counters == 19);
+    assert(report.max_stale_counters == 6);
+    assert(!report.passed());
+  }
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Measures checking throughput of text and binary streams. */
+static void run_benchmarks(void) {
+  const size_t N = 4000000;
+  DeterministicGenerator g(VirtualClock(T, 1000), WyrandRandom(42));
+  std::vector<uint8_t> ids(16 * N);
+  std::vector<char> text(26 * N);
+  g.generate_many(N, ids.data(), nullptr);
+  for (size_t i = 0; i < N; i++) {
+    encode(ids.data() + 16 * i, text.data() + 26 * i);
+    text[26 * i + 25] = '\n';
+  }
+
+  Checker text_checker(options_at(T, 20000));
+  uint64_t start = now_ns();
+  text_checker.feed_text(text.data(), text.size());
+  double text_ns = (double)(now_ns() - start);
+
+  Checker binary_checker(options_at(T, 20000));
+  start = now_ns();
+  binary_checker.feed_binary(ids.data(), N);
+  double binary_ns = (double)(now_ns() - start);
+
+  printf("text:   %6.2f ns/id  %5.2f GB/s  (%s)\n", text_ns / N,
+         26.0 * N / text_ns, text_checker.report().passed() ? "ok" : "ng");
+  printf("binary: %6.2f ns/id  %5.2f GB/s  (%s)\n", binary_ns / N,
+         16.0 * N / binary_ns, binary_checker.report().passed() ? "ok" : "ng");
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_generator_output();
+  test_renewals();
+  test_counter_overflow();
+  test_injected_faults();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,319 @@
+/** clock.hpp - Clock sources for SCRU128 generators */
+
+#ifndef SCRU128_CLOCK_HPP
+#define SCRU128_CLOCK_HPP
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace scru128 {
+
+/**
+ * Identifies the time source behind a clock type.
+ *
+ * Every clock type used with a generator exposes `uint64_t now_ms()`, which
+ * returns the current Unix timestamp in milliseconds, and a `SOURCE` constant
+ * so that the source in use is visible at the call site. The sources trade
+ * accuracy against cost as follows (typical x86-64 Linux figures):
+ *
+ * | Source            | Cost per read | Accuracy                            |
+ * | ----------------- | ------------- | ----------------------------------- |
+ * | `REALTIME`        | ~20 ns (vDSO) | exact wall clock                    |
+ * | `REALTIME_COARSE` | ~5 ns (vDSO)  | lags wall clock by about one tick   |
+ * | `TSC`             | ~7 ns         | drifts between calibrations (< 1ms) |
+ *
+ * `VIRTUAL` denotes a clock driven by the program instead of real time.
+ */
+enum class ClockSource { REALTIME, REALTIME_COARSE, TSC, VIRTUAL };
+
+/** Reads a POSIX clock and converts it into milliseconds. */
+inline uint64_t read_posix_clock_ms(clockid_t clock_id) {
+  struct timespec ts;
+  clock_gettime(clock_id, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * Reads `CLOCK_REALTIME` on every call.
+ *
+ * This is the most accurate and the most expensive source, and it is the
+ * default clock of generators.
+ */
+struct RealtimeClock {
+  static constexpr ClockSource SOURCE = ClockSource::REALTIME;
+
+  uint64_t now_ms() { return read_posix_clock_ms(CLOCK_REALTIME); }
+};
+
+/**
+ * Reads `CLOCK_REALTIME_COARSE`, the wall clock as of the last timer tick.
+ *
+ * The read is a plain memory load from the vDSO page, but the value is updated
+ * only once per kernel tick (1-4 ms depending on `CONFIG_HZ`; see
+ * `resolution_ms()`), or even less often on an idle tickless CPU. Consequently,
+ * a generator observes the same timestamp for several milliseconds and then a
+ * jump, which is harmless to the monotonic order but concentrates IDs on fewer
+ * `timestamp` values. Falls back to
+ * `CLOCK_REALTIME` where the coarse clock is unavailable.
+ */
+struct CoarseRealtimeClock {
+  static constexpr ClockSource SOURCE = ClockSource::REALTIME_COARSE;
+
+#ifdef CLOCK_REALTIME_COARSE
+  static constexpr clockid_t CLOCK_ID = CLOCK_REALTIME_COARSE;
+#else
+  static constexpr clockid_t CLOCK_ID = CLOCK_REALTIME;
+#endif
+
+  uint64_t now_ms() { return read_posix_clock_ms(CLOCK_ID); }
+
+  /** Returns the update interval of the clock, rounded up to milliseconds. */
+  static uint64_t resolution_ms() {
+    struct timespec res;
+    if (clock_getres(CLOCK_ID, &res) != 0) {
+      return 1;
+    }
+    uint64_t ns = (uint64_t)res.tv_sec * 1000000000 + (uint64_t)res.tv_nsec;
+    return ns < 1000000 ? 1 : (ns + 999999) / 1000000;
+  }
+};
+
+/**
+ * Extrapolates the wall clock from the CPU time-stamp counter.
+ *
+ * The clock records a pair of (`CLOCK_REALTIME`, tick count) readings at
+ * construction and at every calibration, and converts subsequent tick counts
+ * into Unix time using the tick rate measured between calibrations. A read
+ * costs one `rdtsc` instruction and a multiplication; `CLOCK_REALTIME` is read
+ * only once per `calibration_interval_ms`.
+ *
+ * The extrapolated time drifts from the wall clock as the tick rate estimate
+ * errs and as NTP slews the wall clock. Each calibration snaps the clock back
+ * to the wall clock, so the clock may step backward by the accumulated drift.
+ * Such a step is a small clock rollback from the viewpoint of a generator,
+ * which keeps using the last `timestamp` until the clock catches up as per the
+ * clock rollback handling rules; `last_drift_ns()` reports the size of the
+ * last correction. The drift stays well below one millisecond with the default
+ * one-second interval on hardware with an invariant TSC (`constant_tsc` and
+ * `nonstop_tsc` CPU flags). On other architectures, the clock uses the
+ * architectural counter (`cntvct_el0` on AArch64) or `CLOCK_MONOTONIC_RAW`.
+ *
+ * An instance is not thread-safe; use one instance per generator.
+ */
+class TscClock {
+ public:
+  static constexpr ClockSource SOURCE = ClockSource::TSC;
+
+  /**
+   * Calibrates the clock, spinning for `warmup_ms` to measure the tick rate.
+   * The measurement starts over if the wall clock steps back meanwhile, so
+   * that the clock never starts from an unmeasured rate.
+   *
+   * @param calibration_interval_ms interval between re-calibrations
+   * @param warmup_ms duration of the initial tick rate measurement (at least
+   * one millisecond is taken)
+   */
+  explicit TscClock(uint64_t calibration_interval_ms = 1000,
+                    uint64_t warmup_ms = 10)
+      : interval_ms_(calibration_interval_ms) {
+    uint64_t warmup_ns = (warmup_ms > 0 ? warmup_ms : 1) * 1000000;
+    uint64_t ns0 = read_realtime_ns();
+    uint64_t tick0 = read_ticks();
+    for (;;) {
+      uint64_t ns1 = read_realtime_ns();
+      uint64_t tick1 = read_ticks();
+      if (ns1 < ns0 || tick1 < tick0) {
+        ns0 = ns1; // stepped back; measure from here
+        tick0 = tick1;
+      } else if (ns1 - ns0 >= warmup_ns && tick1 > tick0) {
+        origin_ns_ = ns0;
+        origin_tick_ = tick0;
+        rebase(ns1, tick1);
+        return;
+      }
+    }
+  }
+
+  uint64_t now_ms() {
+    uint64_t tick = read_ticks();
+    if (tick >= next_calibration_tick_) {
+      calibrate(tick);
+      tick = base_tick_;
+    }
+    uint64_t ns = base_ns_ + (uint64_t)(((unsigned __int128)(tick - base_tick_) *
+                                         ns_per_tick_q32_) >>
+                                        32);
+    return ns / 1000000;
+  }
+
+  /**
+   * Returns the difference between the extrapolated time and the wall clock
+   * observed at the last calibration, in nanoseconds. A positive value means
+   * the clock ran ahead of the wall clock and stepped back at calibration.
+   */
+  int64_t last_drift_ns() const { return last_drift_ns_; }
+
+  /** Returns the measured tick rate in ticks per second. */
+  double ticks_per_second() const { return 4294967296e9 / ns_per_tick_q32_; }
+
+  /** Reads the raw tick counter. */
+  static uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+  }
+
+ private:
+  static uint64_t read_realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+  }
+
+  void calibrate(uint64_t tick) {
+    uint64_t extrapolated =
+        base_ns_ + (uint64_t)(((unsigned __int128)(tick - base_tick_) *
+                               ns_per_tick_q32_) >>
+                              32);
+    uint64_t ns = read_realtime_ns();
+    last_drift_ns_ = (int64_t)(extrapolated - ns);
+    rebase(ns, read_ticks());
+  }
+
+  /**
+   * Re-anchors the clock at (`ns`, `tick`) and re-estimates the tick rate over
+   * the whole period since construction, which averages out read jitter. The
+   * estimate restarts from the new anchor if the wall clock has been stepped
+   * back past the origin.
+   */
+  void rebase(uint64_t ns, uint64_t tick) {
+    if (ns <= origin_ns_ || tick <= origin_tick_) {
+      origin_ns_ = ns;
+      origin_tick_ = tick;
+    } else {
+      ns_per_tick_q32_ = (uint64_t)(((unsigned __int128)(ns - origin_ns_)
+                                     << 32) /
+                                    (tick - origin_tick_));
+    }
+    base_ns_ = ns;
+    base_tick_ = tick;
+    uint64_t interval_ticks = (uint64_t)(
+        ((unsigned __int128)interval_ms_ * 1000000 << 32) / ns_per_tick_q32_);
+    next_calibration_tick_ = tick + interval_ticks;
+  }
+
+  uint64_t interval_ms_;
+  uint64_t origin_ns_ = 0;
+  uint64_t origin_tick_ = 0;
+  uint64_t base_ns_ = 0;
+  uint64_t base_tick_ = 0;
+  uint64_t ns_per_tick_q32_ = (uint64_t)1 << 32; // nanoseconds per tick * 2^32
+  uint64_t next_calibration_tick_ = 0;
+  int64_t last_drift_ns_ = 0;
+};
+
+/**
+ * Returns a time set and advanced by the program rather than real time.
+ *
+ * This clock is meant for tests, simulations, and reproducible load
+ * generation. Besides explicit `set()` and `advance()`, the clock can advance
+ * by itself by one millisecond every `reads_per_ms` reads, which emulates a
+ * generator producing IDs at a fixed rate independent of the host speed.
+ */
+class VirtualClock {
+ public:
+  static constexpr ClockSource SOURCE = ClockSource::VIRTUAL;
+
+  /**
+   * @param start_ms initial Unix timestamp in milliseconds
+   * @param reads_per_ms number of reads per millisecond of automatic
+   * advancement, or zero to advance only explicitly
+   */
+  explicit VirtualClock(uint64_t start_ms = 0, uint64_t reads_per_ms = 0)
+      : now_(start_ms), reads_per_ms_(reads_per_ms) {}
+
+  uint64_t now_ms() {
+    uint64_t now = now_;
+    if (reads_per_ms_ != 0 && ++reads_ == reads_per_ms_) {
+      reads_ = 0;
+      now_++;
+    }
+    return now;
+  }
+
+  /** Sets the current time. */
+  void set(uint64_t unix_ts_ms) { now_ = unix_ts_ms; }
+
+  /** Moves the current time forward by `ms` milliseconds. */
+  void advance(uint64_t ms) { now_ += ms; }
+
+  /** Moves the current time backward by `ms` milliseconds. */
+  void rewind(uint64_t ms) { now_ -= ms; }
+
+  /**
+   * Stops or restarts automatic advancement; a clock with `reads_per_ms` set
+   * at zero stays frozen until it is set explicitly.
+   */
+  void set_reads_per_ms(uint64_t reads_per_ms) {
+    reads_per_ms_ = reads_per_ms;
+    reads_ = 0;
+  }
+
+ private:
+  uint64_t now_;
+  uint64_t reads_per_ms_;
+  uint64_t reads_ = 0;
+};
+
+/**
+ * Returns a time computed by a script from the number of preceding reads.
+ *
+ * `script(n)` is called on the `n`-th read (starting at zero) and returns the
+ * Unix timestamp in milliseconds to report, which allows a simulation to
+ * express adversarial clocks such as periodic backward jumps as a closed-form
+ * function:
+ *
+ *     // one millisecond per 1000 reads, stepping back 4 ms every 10 ms
+ *     auto script = [](uint64_t n) { return T + n / 1000 - n / 10000 * 5; };
+ *     Generator<ScriptedClock<decltype(script)>> g({script});
+ */
+template <class Script> struct ScriptedClock {
+  static constexpr ClockSource SOURCE = ClockSource::VIRTUAL;
+
+  Script script;
+  uint64_t reads = 0;
+
+  uint64_t now_ms() { return script(reads++); }
+};
+
+/**
+ * Refers to a clock owned elsewhere, so that a test can drive a single clock
+ * shared by several generators or generator handles.
+ */
+template <class Clock> class ClockRef {
+ public:
+  static constexpr ClockSource SOURCE = Clock::SOURCE;
+
+  explicit ClockRef(Clock *clock) : clock_(clock) {}
+
+  uint64_t now_ms() { return clock_->now_ms(); }
+
+ private:
+  Clock *clock_;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_CLOCK_HPP */
@@ -0,0 +1,297 @@
+/** codec.hpp - Base36 encoder and decoder for native 128-bit integers
+ *
+ * All functions are `constexpr` and can convert constants at compile time
+ * (see also the `_scru128` literal in `id.hpp`).
+ */
+
+#ifndef SCRU128_CODEC_HPP
+#define SCRU128_CODEC_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+#include "probes.h"
+
+namespace scru128 {
+
+/** Base36 digit characters. */
+constexpr char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+/** Uppercase Base36 digit characters, also accepted by the decoders. */
+constexpr char UPPER_DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+/**
+ * Encodes a 128-bit unsigned integer given as two native 64-bit words in the
+ * 25 Base36 digits, without terminating NUL.
+ *
+ * Unlike `encode()` in `base36_128.c`, which runs a generic base conversion
+ * over a byte array, this function keeps the integer in four 32-bit limbs and
+ * repeatedly divides it by 36^6, the largest power of 36 that fits in 32 bits,
+ * so that every division is a 64-bit division by a constant that compilers
+ * turn into a multiplication. Each 6-digit remainder is then split into digits
+ * with 32-bit arithmetic.
+ *
+ * @param hi most significant 64 bits
+ * @param lo least significant 64 bits
+ * @param out 25-byte character array
+ * @param digits digit characters, `DIGITS` or `UPPER_DIGITS`
+ */
+constexpr void encode_words(uint64_t hi, uint64_t lo, char *out,
+                            const char *digits = DIGITS) {
+  const uint64_t BASE = 2176782336; // 36^6
+  uint32_t limbs[4] = {(uint32_t)(hi >> 32), (uint32_t)hi,
+                       (uint32_t)(lo >> 32), (uint32_t)lo};
+
+  // fill in `out` from right to left, six digits per division pass
+  for (int end = 25; end > 0; end -= 6) {
+    uint64_t rem = 0;
+    for (int i = 0; i < 4; i++) {
+      uint64_t cur = rem << 32 | limbs[i];
+      limbs[i] = (uint32_t)(cur / BASE);
+      rem = cur % BASE;
+    }
+
+    uint32_t chunk = (uint32_t)rem;
+    for (int j = end - 1; j >= 0 && j >= end - 6; j--) {
+      out[j] = digits[chunk % 36];
+      chunk /= 36;
+    }
+  }
+}
+
+/**
+ * Encodes a 128-bit byte array in a 25-digit Base36 string.
+ *
+ * @param bytes 16-byte byte array
+ * @param out 26-byte string (25 digits and terminating NUL)
+ */
+constexpr void encode(const uint8_t *bytes, char *out) {
+  uint64_t hi = 0, lo = 0;
+  for (int i = 0; i < 8; i++) {
+    hi = hi << 8 | bytes[i];
+    lo = lo << 8 | bytes[i + 8];
+  }
+  encode_words(hi, lo, out);
+  out[25] = '\0';
+}
+
+/**
+ * Encodes `n` consecutive 16-byte byte arrays in 26-byte strings.
+ *
+ * @param bytes `n` * 16-byte byte array
+ * @param n number of IDs
+ * @param out `n` * 26-byte character array
+ */
+constexpr void encode_many(const uint8_t *bytes, size_t n, char *out) {
+  for (size_t i = 0; i < n; i++) {
+    encode(bytes + 16 * i, out + 26 * i);
+  }
+}
+
+/**
+ * O(1) map from ASCII code points to Base36 digit values, with 0xff for
+ * invalid characters; the same table as in `decode()` of `base36_128.c`.
+ */
+constexpr uint8_t DECODE_MAP[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c,
+    0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+    0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff};
+
+/**
+ * Decodes 25 Base36 digits into a 128-bit unsigned integer given as two
+ * native 64-bit words. The digits need not be followed by NUL, but all the 25
+ * bytes must be readable (see `decode_string()` for NUL-terminated strings).
+ *
+ * The digits are accumulated in three 64-bit integers (1 + 12 + 12 digits, as
+ * 36^12 < 2^64), which form independent dependency chains, and the partial
+ * values are combined with two 128-bit multiply-adds. Values beyond 128 bits
+ * are rejected by comparing the leading 13 digits with their maximum instead
+ * of checking every multiplication for overflow.
+ *
+ * @param text 25-byte character array
+ * @param hi receives the most significant 64 bits
+ * @param lo receives the least significant 64 bits
+ * @return zero on success or non-zero on failure
+ */
+constexpr int decode_words(const char *text, uint64_t *hi, uint64_t *lo) {
+  typedef unsigned __int128 u128;
+  const uint64_t BASE = 4738381338321616896; // 36^12
+  const u128 MAX_HEAD = ~(u128)0 / BASE;     // max of leading 13 digits
+  const uint64_t MAX_TAIL = (uint64_t)(~(u128)0 - MAX_HEAD * BASE);
+
+  uint64_t parts[3] = {0, 0, 0};
+  uint8_t invalid = 0; // 0xff sets bit 7, which no digit value has
+  parts[0] = DECODE_MAP[(unsigned char)text[0]];
+  invalid |= (uint8_t)parts[0];
+  for (int i = 1; i < 13; i++) {
+    uint8_t mid = DECODE_MAP[(unsigned char)text[i]];
+    uint8_t last = DECODE_MAP[(unsigned char)text[i + 12]];
+    invalid |= mid | last;
+    parts[1] = parts[1] * 36 + mid;
+    parts[2] = parts[2] * 36 + last;
+  }
+  if (invalid & 0x80) {
+    // locate the first invalid digit character
+    int i = 0;
+    while (DECODE_MAP[(unsigned char)text[i]] != 0xff) {
+      i++;
+    }
+    if (!std::is_constant_evaluated()) {
+      SCRU128_PROBE1(decode_invalid_digit, i);
+    }
+    return -1; // invalid digit character
+  }
+
+  u128 head = (u128)parts[0] * BASE + parts[1];
+  if (head > MAX_HEAD || (head == MAX_HEAD && parts[2] > MAX_TAIL)) {
+    if (!std::is_constant_evaluated()) {
+      SCRU128_PROBE0(decode_out_of_range);
+    }
+    return -1; // out of 128-bit value range
+  }
+  u128 value = head * BASE + parts[2];
+  *hi = (uint64_t)(value >> 64);
+  *lo = (uint64_t)value;
+  return 0; // success
+}
+
+/**
+ * Decodes a 25-digit Base36 string into two native 64-bit words.
+ *
+ * Unlike `decode_words()`, this function reads no further than the
+ * terminating NUL of a shorter string.
+ *
+ * @param text 26-byte string (25 digits and terminating NUL)
+ * @param hi receives the most significant 64 bits
+ * @param lo receives the least significant 64 bits
+ * @return zero on success or non-zero on failure
+ */
+constexpr int decode_string(const char *text, uint64_t *hi, uint64_t *lo) {
+  int len = 0;
+  while (len < 26 && text[len] != '\0') {
+    len++;
+  }
+  if (len != 25) {
+    if (!std::is_constant_evaluated()) {
+      SCRU128_PROBE0(decode_invalid_length);
+    }
+    return -1; // invalid length
+  }
+  return decode_words(text, hi, lo);
+}
+
+/**
+ * Extracts the 48-bit `timestamp` field (the top 48 bits) from 25 Base36
+ * digits, decoding only the leading 12 digits in most cases.
+ *
+ * The leading 12 digits `d` confine the value to `[d * 36^13, (d + 1) *
+ * 36^13)`, and as `36^13 / 2^80 = 3^26 / 2^54`, the timestamp is `d * 3^26 >>
+ * 54` unless the interval straddles a multiple of `2^80`, which a bound check
+ * on the low 54 bits of `d * 3^26` detects. Only in that case, which occurs
+ * with a probability of about 1/7000 for random IDs, are all the 25 digits
+ * decoded. The trailing 13 digits are otherwise not examined, so an invalid
+ * character there goes unnoticed; use `decode_words()` to validate IDs.
+ *
+ * @param text 25-byte character array
+ * @param out receives the `timestamp` field
+ * @return zero on success or non-zero on failure
+ */
+constexpr int extract_timestamp(const char *text, uint64_t *out) {
+  typedef unsigned __int128 u128;
+  const uint64_t FACTOR = 2541865828329;  // 3^26
+  const uint64_t MASK = (1ull << 54) - 1; // bits below the timestamp
+
+  uint64_t parts[2] = {0, 0};
+  uint8_t invalid = 0;
+  for (int i = 0; i < 6; i++) {
+    uint8_t first = DECODE_MAP[(unsigned char)text[i]];
+    uint8_t second = DECODE_MAP[(unsigned char)text[i + 6]];
+    invalid |= first | second;
+    parts[0] = parts[0] * 36 + first;
+    parts[1] = parts[1] * 36 + second;
+  }
+  if (invalid & 0x80) {
+    return -1; // invalid digit character
+  }
+
+  u128 scaled = (u128)(parts[0] * 2176782336 + parts[1]) * FACTOR; // 36^6
+  uint64_t timestamp = (uint64_t)(scaled >> 54);
+  if (((uint64_t)scaled & MASK) <= MASK + 1 - FACTOR &&
+      timestamp <= 0xffffffffffff) {
+    *out = timestamp;
+    return 0; // success
+  }
+
+  // resolve the interval straddling a timestamp boundary or 2^128
+  uint64_t hi = 0, lo = 0;
+  if (decode_words(text, &hi, &lo) != 0) {
+    return -1;
+  }
+  *out = hi >> 16;
+  return 0; // success
+}
+
+/**
+ * Extracts the `timestamp` field from `n` consecutive 26-byte records of 25
+ * Base36 digits each (followed by NUL or a line break, which is not read).
+ *
+ * @param texts `n` * 26-byte character array
+ * @param n number of IDs
+ * @param out receives `n` `timestamp` values, or `UINT64_MAX` for records
+ * that could not be decoded
+ * @return number of records that could not be decoded
+ */
+constexpr size_t extract_timestamps(const char *texts, size_t n,
+                                    uint64_t *out) {
+  size_t invalid = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (extract_timestamp(texts + 26 * i, out + i) != 0) {
+      out[i] = UINT64_MAX;
+      invalid++;
+    }
+  }
+  return invalid;
+}
+
+/**
+ * Decodes a 128-bit byte array from a 25-digit Base36 string.
+ *
+ * @param text 26-byte string (25 digits and terminating NUL)
+ * @param out 16-byte byte array
+ * @return zero on success or non-zero on failure
+ */
+constexpr int decode(const char *text, uint8_t *out) {
+  uint64_t hi, lo;
+  if (decode_string(text, &hi, &lo) != 0) {
+    return -1;
+  }
+  for (int i = 0; i < 8; i++) {
+    out[i] = (uint8_t)(hi >> (56 - 8 * i));
+    out[i + 8] = (uint8_t)(lo >> (56 - 8 * i));
+  }
+  return 0; // success
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_CODEC_HPP */
@@ -0,0 +1,210 @@
+/** codec_test.cpp - Tests for codec.hpp */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+#include "codec.hpp"
+
+using namespace scru128;
+
+/** Encodes a byte array with the naive algorithm shown in the README. */
+static void encode_naive(const uint8_t *bytes, char *out) {
+  uint8_t digit_values[25] = {0};
+  for (int i = 0; i < 16; i++) {
+    unsigned int carry = bytes[i];
+    for (int j = 24; j >= 0; j--) {
+      carry += digit_values[j] * 256;
+      digit_values[j] = carry % 36;
+      carry = carry / 36;
+    }
+  }
+  for (int i = 0; i < 25; i++) {
+    out[i] = DIGITS[digit_values[i]];
+  }
+  out[25] = '\0';
+}
+
+/** Executes the implementation against prepared test cases. */
+static void test_positive_cases(void) {
+  struct TestCase {
+    uint8_t bytes[16];
+    char text[26];
+  };
+
+  const struct TestCase test_vector[] = {
+      {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+       "0000000000000000000000000"},
+      {{0x01, 0x7f, 0xee, 0x7f, 0xef, 0x41, 0x7e, 0x2b, 0x34, 0x32, 0xac, 0x2e,
+        0xc5, 0x53, 0x68, 0x7c},
+       "0372hg16csmsm50l8dikcvukc"},
+      {{0x01, 0x7f, 0xee, 0x7f, 0xef, 0x42, 0x7e, 0x2b, 0x34, 0x6c, 0x0f, 0xf4,
+        0x14, 0xbb, 0xcf, 0xfd},
+       "0372hg16cy3nowracls909wcd"},
+      {{0x01, 0x7f, 0xef, 0x39, 0xc2, 0x64, 0x1b, 0xa5, 0x6a, 0x94, 0x83, 0x18,
+        0x88, 0x41, 0xe0, 0x5a},
+       "0372ijojuxuhjsfkeryi2mrtm"},
+      {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff},
+       "f5lxx1zz5pnorynqglhzmsp33"}};
+  const int N_CASES = 5;
+
+  for (int i = 0; i < N_CASES; i++) {
+    const struct TestCase *e = &test_vector[i];
+
+    char out_text[26];
+    encode(e->bytes, out_text);
+    assert(memcmp(e->text, out_text, 26) == 0);
+
+    uint8_t out_bytes[16];
+    int err = decode(e->text, out_bytes);
+    assert(err == 0);
+    assert(memcmp(e->bytes, out_bytes, 16) == 0);
+  }
+}
+
+/** Encodes and decodes in constant expressions. */
+static void test_constexpr(void) {
+  static_assert([] {
+    uint8_t bytes[16] = {};
+    char text[26] = {};
+    if (decode("0372hg16csmsm50l8dikcvukc", bytes) != 0) {
+      return false;
+    }
+    encode(bytes, text);
+    return bytes[0] == 0x01 && bytes[15] == 0x7c && text[24] == 'c' &&
+           text[25] == '\0';
+  }());
+  static_assert([] {
+    uint8_t bytes[16] = {};
+    return decode("0", bytes) != 0 &&
+           decode("f5lxx1zz5pnorynqglhzmsp34", bytes) != 0;
+  }());
+}
+
+/** Executes the implementation against test cases that return error. */
+static void test_negative_cases(void) {
+  uint8_t out_bytes[16];
+  int err;
+  err = decode("0", out_bytes);
+  assert(err != 0);
+  err = decode("00000000000000000000000000", out_bytes);
+  assert(err != 0);
+  err = decode("f5lxx1zz5pn+rynqglhzmsp33", out_bytes);
+  assert(err != 0);
+  err = decode("f5lxx1zz5pnorynqglhzmsp34", out_bytes);
+  assert(err != 0);
+  err = decode("zzzzzzzzzzzzzzzzzzzzzzzzz", out_bytes);
+  assert(err != 0);
+  err = decode("F5LXX1ZZ5PNORYNQGLHZMSP33", out_bytes);
+  assert(err == 0);
+}
+
+/** Compares the implementation with the naive algorithm on random inputs. */
+static void test_random_cases(void) {
+  static uint8_t bytes[16 * 10000];
+  static char texts[26 * 10000];
+  getrandom(bytes, sizeof(bytes), 0);
+  encode_many(bytes, 10000, texts);
+  for (int i = 0; i < 10000; i++) {
+    char expected[26];
+    encode_naive(bytes + 16 * i, expected);
+    assert(memcmp(expected, texts + 26 * i, 26) == 0);
+
+    uint8_t decoded[16];
+    assert(decode(texts + 26 * i, decoded) == 0);
+    assert(memcmp(bytes + 16 * i, decoded, 16) == 0);
+  }
+}
+
+/** Extracts timestamps around every kind of boundary and from random IDs. */
+static void test_extract_timestamp(void) {
+  typedef unsigned __int128 u128;
+  const uint64_t timestamps[] = {0,          1,           0x017fee7fef41,
+                                 0xabcdef12, 0xfffffffffffe, 0xffffffffffff};
+  for (uint64_t t : timestamps) {
+    // the first and last values of `t` and of the neighboring timestamps
+    u128 values[] = {(u128)t << 80, ((u128)t << 80) + 1,
+                     ((u128)t << 80) - 1, ((u128)t << 80 | ~(u128)0 >> 48)};
+    for (u128 value : values) {
+      char text[26];
+      uint64_t hi = (uint64_t)(value >> 64);
+      encode_words(hi, (uint64_t)value, text);
+      text[25] = '\0';
+      uint64_t timestamp;
+      assert(extract_timestamp(text, &timestamp) == 0);
+      assert(timestamp == hi >> 16);
+    }
+  }
+
+  static uint8_t bytes[16 * 10000];
+  static char texts[26 * 10000];
+  static uint64_t extracted[10000];
+  getrandom(bytes, sizeof(bytes), 0);
+  encode_many(bytes, 10000, texts);
+  memcpy(texts + 26 * 7, "0000000000+00000000000000", 25);
+  memcpy(texts + 26 * 8, "f5lxx1zz5pnorynqglhzmsp34", 25);
+  assert(extract_timestamps(texts, 10000, extracted) == 2);
+  for (int i = 0; i < 10000; i++) {
+    uint64_t expected = 0;
+    for (int j = 0; j < 6; j++) {
+      expected = expected << 8 | bytes[16 * i + j];
+    }
+    assert(extracted[i] == (i == 7 || i == 8 ? UINT64_MAX : expected));
+  }
+
+  static_assert([] {
+    uint64_t timestamp = 0;
+    return extract_timestamp("0372hg16csmsm50l8dikcvukc", &timestamp) == 0 &&
+           timestamp == 0x017fee7fef41;
+  }());
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Compares timestamp extraction with full decoding. */
+static void run_benchmarks(void) {
+  const size_t N = 1000000;
+  static uint8_t bytes[16 * N];
+  static char texts[26 * N];
+  static uint64_t timestamps[N];
+  getrandom(bytes, sizeof(bytes), 0);
+  encode_many(bytes, N, texts);
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    uint64_t hi = 0, lo = 0;
+    decode_words(texts + 26 * i, &hi, &lo);
+    timestamps[i] = hi >> 16;
+  }
+  double decode_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  extract_timestamps(texts, N, timestamps);
+  double extract_ns = (double)(now_ns() - start) / N;
+
+  printf("timestamp via decode_words: %5.2f ns/id  extract_timestamps: "
+         "%5.2f ns/id\n",
+         decode_ns, extract_ns);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_positive_cases();
+  test_negative_cases();
+  test_constexpr();
+  test_random_cases();
+  test_extract_timestamp();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,285 @@
+/** collision.hpp - Monte Carlo estimate of ID collisions among generators */
+
+#ifndef SCRU128_COLLISION_HPP
+#define SCRU128_COLLISION_HPP
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "random.hpp"
+
+namespace scru128 {
+
+/** Parameters of `CollisionSimulator`. */
+struct CollisionParams {
+  uint64_t generators = 100;
+  uint64_t ids_per_sec = 10000;
+  uint64_t seconds = 10;
+  int hi_bits = 24;
+  int lo_bits = 24;
+  int entropy_bits = 32;
+  unsigned threads = 0; // zero to use all cores
+  uint64_t seed = 42;
+
+  /** Milliseconds taken by a worker thread at a time. */
+  uint64_t chunk_ms = 250;
+
+  /** Returns true if the parameters are within the supported ranges. */
+  bool valid() const {
+    return hi_bits >= 1 && hi_bits <= 24 && lo_bits >= 1 && lo_bits <= 24 &&
+           entropy_bits >= 1 && entropy_bits <= 32 && generators > 0 &&
+           ids_per_sec <= 1000 * ((uint64_t)1 << lo_bits) && chunk_ms > 0;
+  }
+};
+
+/** Results of `CollisionSimulator::run()`. */
+struct CollisionResult {
+  /** Number of IDs simulated. */
+  uint64_t ids = 0;
+
+  /** Number of IDs that duplicate another ID. */
+  uint64_t collisions = 0;
+
+  /** Number of milliseconds with any collision. */
+  uint64_t colliding_ms = 0;
+
+  /**
+   * Expected number of colliding pairs among IDs from different generators if
+   * the three fields were independent random bits.
+   */
+  double expected = 0.0;
+};
+
+/**
+ * Simulates `generators` distributed generators that each produce
+ * `ids_per_sec` IDs per second for `seconds` seconds with synchronized clocks,
+ * following the three-layer randomness described in the specification, and
+ * counts the IDs that duplicate another ID.
+ *
+ * Every generator draws a `counter_hi` bucket once a second (at its own
+ * phase), a `counter_lo` starting point every millisecond, and `entropy` for
+ * every ID, and increments `counter_lo` within each millisecond, carrying into
+ * `counter_hi`. As in `Generator`, a carried `counter_hi` is kept in the
+ * following milliseconds until the next renewal. A carry out of `counter_hi`,
+ * which the generator turns into an increment of `timestamp`, only wraps
+ * `counter_hi` around here; it is too rare to matter at full width.
+ *
+ * IDs with different `timestamp` values never collide, so the simulation is
+ * sharded by `timestamp`: worker threads take chunks of `chunk_ms`
+ * milliseconds from a shared cursor, replay the carries of each generator
+ * from its last renewal up to the chunk, and find duplicates within each
+ * millisecond in their own open-addressing hash sets, without any locking. All
+ * random values are derived from the seed and the generator and millisecond
+ * numbers, so the counts are reproducible regardless of the number of threads
+ * and the size of chunks.
+ */
+class CollisionSimulator {
+ public:
+  /** @param params parameters, which must be `valid()` */
+  explicit CollisionSimulator(const CollisionParams &params)
+      : p_(params), lo_mask_((1ull << params.lo_bits) - 1),
+        phases_(params.generators) {
+    for (uint64_t g = 0; g < p_.generators; g++) {
+      phases_[g] = stream_seed(g, ~0ull) % 1000;
+    }
+  }
+
+  /** Runs the simulation on `threads` threads (at least one). */
+  CollisionResult run() const {
+    unsigned n_threads =
+        p_.threads > 0 ? p_.threads : std::thread::hardware_concurrency();
+    n_threads = n_threads > 0 ? n_threads : 1;
+
+    Totals totals;
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < n_threads; t++) {
+      threads.emplace_back([this, &totals] { run_worker(totals); });
+    }
+    run_worker(totals);
+    for (auto &th : threads) {
+      th.join();
+    }
+
+    CollisionResult result;
+    result.ids = totals.ids;
+    result.collisions = totals.collisions;
+    result.colliding_ms = totals.colliding_ms;
+    result.expected = totals.expected;
+    return result;
+  }
+
+  /** Returns the parameters. */
+  const CollisionParams &params() const { return p_; }
+
+ private:
+  typedef unsigned __int128 u128;
+
+  /** Totals accumulated by worker threads. */
+  struct Totals {
+    std::atomic<uint64_t> cursor{0};
+    std::atomic<uint64_t> ids{0};
+    std::atomic<uint64_t> collisions{0};
+    std::atomic<uint64_t> colliding_ms{0};
+    std::atomic<double> expected{0.0};
+  };
+
+  /**
+   * Open-addressing set of keys below 2^80 that are stored plus one, so that
+   * zero marks an empty slot.
+   */
+  class KeySet {
+   public:
+    explicit KeySet(size_t max_keys) {
+      size_t capacity = 16;
+      while (capacity < 2 * max_keys) {
+        capacity *= 2;
+      }
+      slots_.resize(capacity);
+      shift_ = 64 - __builtin_ctzll(capacity);
+    }
+
+    void clear() { memset(slots_.data(), 0, slots_.size() * sizeof(u128)); }
+
+    /** Inserts `key` and returns false if it is already in the set. */
+    bool insert(u128 key) {
+      u128 stored = key + 1;
+      uint64_t h =
+          ((uint64_t)key ^ (uint64_t)(key >> 64)) * 0x9e3779b97f4a7c15;
+      size_t mask = slots_.size() - 1;
+      for (size_t i = h >> shift_;; i = (i + 1) & mask) {
+        if (slots_[i] == 0) {
+          slots_[i] = stored;
+          return true;
+        } else if (slots_[i] == stored) {
+          return false;
+        }
+      }
+    }
+
+   private:
+    std::vector<u128> slots_;
+    int shift_;
+  };
+
+  /** Returns a seed for the random stream identified by `a` and `b`. */
+  uint64_t stream_seed(uint64_t a, uint64_t b) const {
+    return WyrandRandom(WyrandRandom(p_.seed + a).next_u64() + b).next_u64();
+  }
+
+  /** Returns the number of IDs that generator `g` produces in `ms`. */
+  uint64_t ids_in_ms(uint64_t g, uint64_t ms) const {
+    return (p_.ids_per_sec * (ms + phases_[g] + 1)) / 1000 -
+           (p_.ids_per_sec * (ms + phases_[g])) / 1000;
+  }
+
+  /** Returns the second of generator `g` (at its own phase) that has `ms`. */
+  uint64_t epoch(uint64_t g, uint64_t ms) const {
+    return (ms + phases_[g]) / 1000;
+  }
+
+  /** Returns the first millisecond of the second of `g` that has `ms`. */
+  uint64_t epoch_start(uint64_t g, uint64_t ms) const {
+    uint64_t start = epoch(g, ms) * 1000;
+    return start > phases_[g] ? start - phases_[g] : 0;
+  }
+
+  /** Returns the random stream of `g` in `ms`, `counter_lo` first. */
+  WyrandRandom random_in_ms(uint64_t g, uint64_t ms) const {
+    return WyrandRandom(stream_seed(g, ms << 1 | 1));
+  }
+
+  /**
+   * Returns the number of carries from `counter_lo` into `counter_hi` among
+   * `k` IDs that start at `counter_lo`.
+   */
+  uint64_t carries(uint64_t counter_lo, uint64_t k) const {
+    return k > 0 ? (counter_lo + k - 1) >> p_.lo_bits : 0;
+  }
+
+  void run_worker(Totals &totals) const {
+    const uint64_t hi_mask = (1ull << p_.hi_bits) - 1;
+    const uint64_t entropy_mask = (1ull << p_.entropy_bits) - 1;
+    const double pair_probability =
+        1.0 /
+        (double)((u128)1 << (p_.hi_bits + p_.lo_bits + p_.entropy_bits));
+    const uint64_t total_ms = p_.seconds * 1000;
+
+    KeySet set(p_.generators * ((p_.ids_per_sec + 999) / 1000));
+    std::vector<uint64_t> carried(p_.generators);
+
+    uint64_t ids = 0, collisions = 0, colliding_ms = 0;
+    double expected = 0.0;
+    for (;;) {
+      uint64_t begin =
+          totals.cursor.fetch_add(p_.chunk_ms, std::memory_order_relaxed);
+      if (begin >= total_ms) {
+        break;
+      }
+      uint64_t end =
+          begin + p_.chunk_ms < total_ms ? begin + p_.chunk_ms : total_ms;
+      // replay the carries of each generator since its last renewal
+      for (uint64_t g = 0; g < p_.generators; g++) {
+        carried[g] = 0;
+        for (uint64_t ms = epoch_start(g, begin); ms < begin; ms++) {
+          uint64_t counter_lo = random_in_ms(g, ms).next_u64() & lo_mask_;
+          carried[g] += carries(counter_lo, ids_in_ms(g, ms));
+        }
+      }
+
+      for (uint64_t ms = begin; ms < end; ms++) {
+        set.clear();
+        uint64_t ids_ms = 0, sum_sq = 0, collisions_ms = 0;
+        for (uint64_t g = 0; g < p_.generators; g++) {
+          if (ms == epoch_start(g, ms)) {
+            carried[g] = 0;
+          }
+          uint64_t k = ids_in_ms(g, ms);
+          if (k == 0) {
+            continue;
+          }
+          ids_ms += k;
+          sum_sq += k * k;
+
+          uint64_t renewed =
+              WyrandRandom(stream_seed(g, epoch(g, ms) << 1)).next_u64();
+          uint64_t counter_hi = (renewed + carried[g]) & hi_mask;
+          WyrandRandom random = random_in_ms(g, ms);
+          uint64_t counter_lo = random.next_u64() & lo_mask_;
+          carried[g] += carries(counter_lo, k);
+          for (uint64_t i = 0; i < k; i++) {
+            uint64_t entropy = random.next_u64() & entropy_mask;
+            u128 key = ((u128)(counter_hi << p_.lo_bits | counter_lo))
+                           << p_.entropy_bits |
+                       entropy;
+            collisions_ms += !set.insert(key);
+            if (++counter_lo > lo_mask_) {
+              counter_lo = 0;
+              counter_hi = (counter_hi + 1) & hi_mask;
+            }
+          }
+        }
+        ids += ids_ms;
+        collisions += collisions_ms;
+        colliding_ms += collisions_ms > 0;
+        // pairs of IDs from different generators in this millisecond
+        expected += (double)(ids_ms * ids_ms - sum_sq) / 2 * pair_probability;
+      }
+    }
+
+    totals.ids += ids;
+    totals.collisions += collisions;
+    totals.colliding_ms += colliding_ms;
+    totals.expected.fetch_add(expected);
+  }
+
+  CollisionParams p_;
+  uint64_t lo_mask_;
+  std::vector<uint64_t> phases_;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_COLLISION_HPP */
@@ -0,0 +1,71 @@
+/** collision_test.cpp - Tests for collision.hpp */
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "collision.hpp"
+
+using namespace scru128;
+
+/** Returns small parameters that finish in a fraction of a second. */
+static CollisionParams tiny_params(void) {
+  CollisionParams p;
+  p.generators = 20;
+  p.ids_per_sec = 3000;
+  p.seconds = 3;
+  p.threads = 1;
+  return p;
+}
+
+/** Simulates every ID and finds no collision at full width. */
+static void test_full_width(void) {
+  CollisionParams p = tiny_params();
+  p.threads = 0; // all cores, at least one
+  CollisionResult result = CollisionSimulator(p).run();
+  assert(result.ids == p.generators * p.ids_per_sec * p.seconds);
+  assert(result.collisions == 0 && result.colliding_ms == 0);
+  assert(result.expected > 0.0 && result.expected < 1e-12);
+}
+
+/** Yields the same counts on any number of threads and size of chunks. */
+static void test_reproducible(void) {
+  CollisionParams p = tiny_params();
+  p.hi_bits = 3;
+  p.lo_bits = 2; // carries into counter_hi in most milliseconds
+  p.entropy_bits = 6;
+  CollisionResult base = CollisionSimulator(p).run();
+  assert(base.collisions > 0);
+  for (unsigned threads : {1, 3}) {
+    for (uint64_t chunk_ms : {1, 7, 1000}) {
+      p.threads = threads;
+      p.chunk_ms = chunk_ms;
+      CollisionResult result = CollisionSimulator(p).run();
+      assert(result.ids == base.ids);
+      assert(result.collisions == base.collisions);
+      assert(result.colliding_ms == base.colliding_ms);
+      assert(fabs(result.expected - base.expected) < 1e-9 * base.expected);
+    }
+  }
+  p.seed++;
+  assert(CollisionSimulator(p).run().collisions != base.collisions);
+}
+
+/** Counts about as many collisions as independent random bits would. */
+static void test_narrow_fields(void) {
+  CollisionParams p = tiny_params();
+  p.hi_bits = 5;
+  p.lo_bits = 5;
+  p.entropy_bits = 5;
+  CollisionResult result = CollisionSimulator(p).run();
+  assert(result.expected > 100.0);
+  assert(result.collisions > 0.7 * result.expected);
+  assert(result.collisions < 1.3 * result.expected);
+}
+
+int main(void) {
+  test_full_width();
+  test_reproducible();
+  test_narrow_fields();
+  return 0;
+}
@@ -0,0 +1,368 @@
+/** dedup.hpp - Streaming duplicate detector for IDs from many generators */
+
+#ifndef SCRU128_DEDUP_HPP
+#define SCRU128_DEDUP_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+namespace scru128 {
+
+/**
+ * Open-addressing set of 128-bit IDs given as two native 64-bit words, with
+ * linear probing and a load factor of at most one half. The all-zero ID marks
+ * an empty slot and is tracked separately.
+ */
+class IdSet {
+ public:
+  /**
+   * Inserts an ID.
+   *
+   * @return true if the ID has been inserted or false if it was already in
+   * the set
+   */
+  bool insert(uint64_t hi, uint64_t lo) {
+    if (hi == 0 && lo == 0) {
+      bool inserted = !has_zero_;
+      has_zero_ = true;
+      return inserted;
+    }
+    if (2 * (size_ + 1) > slots_.size()) {
+      grow();
+    }
+    size_t mask = slots_.size() - 1;
+    for (size_t i = home(hi, lo);; i = (i + 1) & mask) {
+      Slot &slot = slots_[i];
+      if (slot.hi == 0 && slot.lo == 0) {
+        slot.hi = hi;
+        slot.lo = lo;
+        size_++;
+        return true;
+      } else if (slot.hi == hi && slot.lo == lo) {
+        return false;
+      }
+    }
+  }
+
+  /** Prefetches the slot where the probe for an ID starts. */
+  void prefetch(uint64_t hi, uint64_t lo) const {
+    if (!slots_.empty()) {
+      __builtin_prefetch(&slots_[home(hi, lo)]);
+    }
+  }
+
+  /** Removes all IDs but keeps the allocated slots for reuse. */
+  void clear() {
+    if (size_ > 0) {
+      memset(slots_.data(), 0, slots_.size() * sizeof(Slot));
+    }
+    size_ = 0;
+    has_zero_ = false;
+  }
+
+  /** Returns the number of IDs in the set. */
+  size_t size() const { return size_ + has_zero_; }
+
+  /** Returns the number of bytes allocated for the slots. */
+  size_t memory_bytes() const { return slots_.size() * sizeof(Slot); }
+
+ private:
+  struct Slot {
+    uint64_t hi;
+    uint64_t lo;
+  };
+
+  /** Returns the index of the slot where the probe for an ID starts. */
+  size_t home(uint64_t hi, uint64_t lo) const {
+    // take the top bits of a multiplicative hash of both words
+    return (size_t)(((lo * 0x9e3779b97f4a7c15) ^ hi) * 0xbf58476d1ce4e5b9 >>
+                    shift_);
+  }
+
+  void grow() {
+    std::vector<Slot> old(slots_.size() < 64 ? 128 : 2 * slots_.size());
+    old.swap(slots_);
+    shift_ = 64 - __builtin_ctzll(slots_.size());
+    size_t mask = slots_.size() - 1;
+    for (const Slot &slot : old) {
+      if (slot.hi != 0 || slot.lo != 0) {
+        size_t i = home(slot.hi, slot.lo);
+        while (slots_[i].hi != 0 || slots_[i].lo != 0) {
+          i = (i + 1) & mask;
+        }
+        slots_[i] = slot;
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  int shift_ = 64; // 64 - log2 of the number of slots
+  size_t size_ = 0;
+  bool has_zero_ = false;
+};
+
+/**
+ * Detects duplicate IDs in a stream of IDs aggregated from many generators.
+ *
+ * Following the design notes of the specification, generators are assigned
+ * to `counter_hi` buckets every second, so IDs that differ in `timestamp /
+ * 1000` or in `counter_hi` can never be duplicates of each other. The
+ * detector partitions each batch of IDs by the hash of that pair into one
+ * shard per thread and checks the shards in parallel, each with its own sets
+ * and without any locking.
+ *
+ * Memory is bounded by the active window rather than by the total volume:
+ * each shard keeps one `IdSet` per second for the newest `window_sec + 1`
+ * seconds seen so far (rounded up to a power of two), in a ring that recycles
+ * the set of the oldest second (keeping its allocation) when a new second
+ * enters the window. IDs older than the window at the point where they
+ * arrive in the stream are counted as late and not checked, so a batch may
+ * span any number of windows; the window should cover the maximum delay with
+ * which IDs arrive from the slowest node.
+ *
+ * The window follows the newest second only by steps of at most
+ * `max_jump_sec`, so that a single far-future or corrupt ID cannot move it
+ * past every real ID. An ID further ahead is counted as an outlier and not
+ * checked, unless `JUMP_CONFIRMATIONS` such IDs in a row agree on a second
+ * (within the window of each other), which is taken as the stream resuming
+ * after a long gap. IDs with the reserved `timestamp` values zero and 2^48 - 1
+ * are always outliers.
+ */
+class Deduplicator {
+ public:
+  /** A duplicate ID found (the second and subsequent occurrences). */
+  struct Duplicate {
+    uint64_t hi;
+    uint64_t lo;
+  };
+
+  /**
+   * @param n_shards number of shards and threads, or zero for the number of
+   * cores
+   * @param window_sec number of seconds behind the newest second to keep
+   * @param max_reported maximum number of duplicates kept for `duplicates()`
+   * @param max_jump_sec greatest number of seconds by which an ID may be
+   * ahead of the newest second to advance the window
+   */
+  explicit Deduplicator(unsigned n_shards = 0, uint64_t window_sec = 10,
+                        size_t max_reported = 1000,
+                        uint64_t max_jump_sec = 3600)
+      : window_sec_(window_sec), max_reported_(max_reported),
+        max_jump_sec_(max_jump_sec) {
+    if (n_shards == 0) {
+      n_shards = std::thread::hardware_concurrency();
+    }
+    shards_.resize(n_shards > 0 ? n_shards : 1);
+    // round the ring size up to a power of two to index it with a mask
+    size_t ring_size = 1;
+    while (ring_size < window_sec + 1) {
+      ring_size *= 2;
+    }
+    for (Shard &shard : shards_) {
+      shard.seconds.resize(ring_size);
+    }
+  }
+
+  /**
+   * Checks a batch of IDs given as pairs of native 64-bit words. Batches of
+   * about a million IDs amortize the cost of dispatching to threads.
+   *
+   * @param words `n` * 2 words, the most significant word of each ID first
+   * @param n number of IDs
+   */
+  void feed_words(const uint64_t *words, size_t n) {
+    for (Shard &shard : shards_) {
+      shard.batch.clear();
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint64_t hi = words[2 * i], lo = words[2 * i + 1];
+      uint64_t second = (hi >> 16) / 1000;
+      if (!advance_window(hi >> 16)) {
+        outlier_count_++;
+        continue;
+      } else if (second + window_sec_ < newest_second_) {
+        // judge lateness by the window in effect when the ID arrives
+        late_count_++;
+        continue;
+      }
+      // map the hash of second and counter_hi to [0, n_shards)
+      uint64_t key = second << 24 | (hi & 0xffff) << 8 | lo >> 56;
+      size_t s = (size_t)(((key * 0x9e3779b97f4a7c15) >> 32) * shards_.size() >>
+                          32);
+      shards_[s].batch.push_back(hi);
+      shards_[s].batch.push_back(lo);
+    }
+    ids_ += n;
+
+    std::vector<std::thread> threads;
+    for (size_t s = 1; s < shards_.size(); s++) {
+      if (!shards_[s].batch.empty()) {
+        threads.emplace_back([this, s] { check_shard(shards_[s]); });
+      }
+    }
+    check_shard(shards_[0]);
+    for (auto &th : threads) {
+      th.join();
+    }
+  }
+
+  /** Checks a batch of 16-byte binary IDs. */
+  void feed_binary(const uint8_t *ids, size_t n) {
+    words_.resize(2 * n);
+    for (size_t i = 0; i < n; i++) {
+      uint64_t hi = 0, lo = 0;
+      for (int j = 0; j < 8; j++) {
+        hi = hi << 8 | ids[16 * i + j];
+        lo = lo << 8 | ids[16 * i + j + 8];
+      }
+      words_[2 * i] = hi;
+      words_[2 * i + 1] = lo;
+    }
+    feed_words(words_.data(), n);
+  }
+
+  /** Returns the number of IDs fed. */
+  uint64_t ids() const { return ids_; }
+
+  /** Returns the number of IDs skipped as reserved or too far ahead. */
+  uint64_t outlier_count() const { return outlier_count_; }
+
+  /** Returns the number of duplicates found. */
+  uint64_t duplicate_count() const {
+    uint64_t count = 0;
+    for (const Shard &shard : shards_) {
+      count += shard.duplicate_count;
+    }
+    return count;
+  }
+
+  /** Returns the number of IDs skipped as older than the window. */
+  uint64_t late_count() const { return late_count_; }
+
+  /** Returns up to `max_reported` duplicates found per shard. */
+  std::vector<Duplicate> duplicates() const {
+    std::vector<Duplicate> all;
+    for (const Shard &shard : shards_) {
+      all.insert(all.end(), shard.reported.begin(), shard.reported.end());
+    }
+    return all;
+  }
+
+  /** Returns the number of bytes allocated for the sets of all shards. */
+  size_t memory_bytes() const {
+    size_t bytes = 0;
+    for (const Shard &shard : shards_) {
+      for (const Second &second : shard.seconds) {
+        bytes += second.set.memory_bytes();
+      }
+    }
+    return bytes;
+  }
+
+ private:
+  struct Second {
+    uint64_t second = UINT64_MAX; // `timestamp / 1000` held in `set`
+    IdSet set;
+  };
+
+  struct Shard {
+    std::vector<Second> seconds; // ring indexed by `second & (size - 1)`
+    std::vector<uint64_t> batch;
+    uint64_t duplicate_count = 0;
+    std::vector<Duplicate> reported;
+  };
+
+  /** Number of IDs ahead whose slots are prefetched. */
+  static constexpr size_t PREFETCH_DISTANCE = 16;
+
+  /** Number of IDs in a row that confirm a jump beyond `max_jump_sec`. */
+  static constexpr uint64_t JUMP_CONFIRMATIONS = 16;
+
+  /**
+   * Moves the window forward to the second of a `timestamp` if needed.
+   *
+   * @return true if the ID is to be checked or false if it is an outlier
+   */
+  bool advance_window(uint64_t timestamp) {
+    if (timestamp == 0 || timestamp == 0xffffffffffff) {
+      return false;
+    }
+    uint64_t second = timestamp / 1000;
+    if (!started_ || second <= newest_second_) {
+      started_ = true;
+      newest_second_ = second > newest_second_ ? second : newest_second_;
+      return true;
+    } else if (second - newest_second_ <= max_jump_sec_) {
+      newest_second_ = second;
+      jump_votes_ = 0;
+      return true;
+    }
+
+    if (jump_votes_ > 0 && second + window_sec_ >= jump_second_ &&
+        second <= jump_second_ + window_sec_) {
+      jump_second_ = second > jump_second_ ? second : jump_second_;
+      jump_votes_++;
+    } else {
+      jump_second_ = second;
+      jump_votes_ = 1;
+    }
+    if (jump_votes_ < JUMP_CONFIRMATIONS) {
+      return false;
+    }
+    newest_second_ = jump_second_;
+    jump_votes_ = 0;
+    return true;
+  }
+
+  void check_shard(Shard &shard) {
+    const std::vector<uint64_t> &batch = shard.batch;
+    const uint64_t ring_mask = shard.seconds.size() - 1;
+    for (size_t i = 0; i < batch.size(); i += 2) {
+      // hide the cache miss of a set much larger than cache
+      if (i + 2 * PREFETCH_DISTANCE < batch.size()) {
+        uint64_t ahead_hi = batch[i + 2 * PREFETCH_DISTANCE];
+        uint64_t ahead_lo = batch[i + 2 * PREFETCH_DISTANCE + 1];
+        uint64_t ahead = (ahead_hi >> 16) / 1000;
+        const Second &slot = shard.seconds[ahead & ring_mask];
+        if (slot.second == ahead) {
+          slot.set.prefetch(ahead_hi, ahead_lo);
+        }
+      }
+
+      uint64_t hi = batch[i], lo = batch[i + 1];
+      uint64_t second = (hi >> 16) / 1000;
+      Second &slot = shard.seconds[second & ring_mask];
+      if (slot.second != second) {
+        // recycle the set of a second that has left the window
+        slot.second = second;
+        slot.set.clear();
+      }
+      if (!slot.set.insert(hi, lo)) {
+        shard.duplicate_count++;
+        if (shard.reported.size() < max_reported_) {
+          shard.reported.push_back({hi, lo});
+        }
+      }
+    }
+  }
+
+  uint64_t window_sec_;
+  size_t max_reported_;
+  std::vector<Shard> shards_;
+  uint64_t max_jump_sec_;
+  std::vector<uint64_t> words_;
+  bool started_ = false;
+  uint64_t newest_second_ = 0;
+  uint64_t jump_second_ = 0;
+  uint64_t jump_votes_ = 0;
+  uint64_t outlier_count_ = 0;
+  uint64_t late_count_ = 0;
+  uint64_t ids_ = 0;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_DEDUP_HPP */
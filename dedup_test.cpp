@@ -0,0 +1,232 @@
+/** dedup_test.cpp - Tests for dedup.hpp */
+
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+#include "clock.hpp"
+#include "dedup.hpp"
+#include "generator.hpp"
+#include "random.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+/**
+ * Generates `n` IDs from each of `n_gens` generators into `words`, advancing
+ * the virtual clock by one millisecond every `ids_per_ms` IDs.
+ */
+static void generate_words(std::vector<uint64_t> &words, int n_gens,
+                           size_t n, uint64_t start_ms,
+                           uint64_t ids_per_ms = 100) {
+  for (int k = 0; k < n_gens; k++) {
+    DeterministicGenerator g(VirtualClock(start_ms, ids_per_ms),
+                             WyrandRandom(k));
+    for (size_t i = 0; i < n; i++) {
+      uint8_t id[16];
+      g.generate(id);
+      uint64_t hi = 0, lo = 0;
+      for (int j = 0; j < 8; j++) {
+        hi = hi << 8 | id[j];
+        lo = lo << 8 | id[j + 8];
+      }
+      words.push_back(hi);
+      words.push_back(lo);
+    }
+  }
+}
+
+/** Inserts IDs into `IdSet` and finds repeated ones. */
+static void test_id_set(void) {
+  IdSet set;
+  for (uint64_t i = 1; i < 100000; i++) {
+    assert(set.insert(i >> 3, i * 0x9e3779b97f4a7c15));
+  }
+  for (uint64_t i = 1; i < 100000; i += 7) {
+    assert(!set.insert(i >> 3, i * 0x9e3779b97f4a7c15));
+  }
+  assert(set.insert(0, 0));
+  assert(!set.insert(0, 0));
+  assert(set.size() == 100000);
+
+  size_t bytes = set.memory_bytes();
+  set.clear();
+  assert(set.size() == 0 && set.memory_bytes() == bytes);
+  assert(set.insert(0, 0));
+}
+
+/** Finds no duplicates among IDs from distinct generators. */
+static void test_distinct_generators(void) {
+  std::vector<uint64_t> words;
+  generate_words(words, 64, 10000, T);
+  Deduplicator dedup(4);
+  dedup.feed_words(words.data(), words.size() / 2);
+  assert(dedup.ids() == 640000);
+  assert(dedup.duplicate_count() == 0);
+  assert(dedup.late_count() == 0);
+}
+
+/** Finds duplicates within and across batches and shards. */
+static void test_injected_duplicates(void) {
+  std::vector<uint64_t> words;
+  generate_words(words, 8, 10000, T);
+  size_t n = words.size() / 2;
+  // replay every 1000th ID in the same batch and the next batch
+  std::vector<uint64_t> replay;
+  for (size_t i = 0; i < n; i += 1000) {
+    replay.push_back(words[2 * i]);
+    replay.push_back(words[2 * i + 1]);
+  }
+  words.insert(words.end(), replay.begin(), replay.end());
+
+  Deduplicator dedup(3);
+  dedup.feed_words(words.data(), words.size() / 2);
+  assert(dedup.duplicate_count() == n / 1000);
+  dedup.feed_words(replay.data(), replay.size() / 2);
+  assert(dedup.duplicate_count() == 2 * (n / 1000));
+
+  std::vector<Deduplicator::Duplicate> found = dedup.duplicates();
+  assert(found.size() == 2 * (n / 1000));
+  for (const Deduplicator::Duplicate &d : found) {
+    bool listed = false;
+    for (size_t i = 0; i < replay.size(); i += 2) {
+      listed |= replay[i] == d.hi && replay[i + 1] == d.lo;
+    }
+    assert(listed);
+  }
+}
+
+/** Skips IDs older than the window and keeps memory bounded. */
+static void test_window(void) {
+  Deduplicator dedup(2, 2);
+  std::vector<uint64_t> first;
+  generate_words(first, 4, 10000, T);
+
+  for (uint64_t s = 0; s < 30; s++) {
+    std::vector<uint64_t> words;
+    generate_words(words, 4, 10000, T + 1000 * s);
+    dedup.feed_words(words.data(), words.size() / 2);
+  }
+  assert(dedup.duplicate_count() == 0);
+  // at most 2 shards * 4 seconds (3 rounded up) * 2^17 slots for 40000 IDs
+  assert(dedup.memory_bytes() <= 2 * 4 * 16 * (1 << 17));
+
+  uint64_t late = dedup.late_count();
+  dedup.feed_words(first.data(), first.size() / 2);
+  assert(dedup.late_count() == late + first.size() / 2);
+}
+
+/** Checks every ID of an in-order batch that spans many windows. */
+static void test_long_batch(void) {
+  std::vector<uint64_t> words;
+  generate_words(words, 1, 100000, T, 1); // 100 seconds
+  // replay every 1000th ID half a second later
+  std::vector<uint64_t> batch;
+  size_t n_replayed = 0;
+  for (size_t i = 0; i < words.size() / 2; i++) {
+    batch.push_back(words[2 * i]);
+    batch.push_back(words[2 * i + 1]);
+    if (i >= 500 && (i - 500) % 1000 == 0) {
+      batch.push_back(words[2 * (i - 500)]);
+      batch.push_back(words[2 * (i - 500) + 1]);
+      n_replayed++;
+    }
+  }
+
+  Deduplicator dedup(3, 10);
+  dedup.feed_words(batch.data(), batch.size() / 2);
+  assert(dedup.late_count() == 0);
+  assert(dedup.duplicate_count() == n_replayed && n_replayed == 100);
+
+  // the start of the same stream is late once the window has moved past it
+  dedup.feed_words(words.data(), 20000);
+  assert(dedup.late_count() == 20000);
+}
+
+/** Keeps detecting duplicates after reserved and far-future IDs. */
+static void test_outliers(void) {
+  std::vector<uint64_t> words;
+  generate_words(words, 2, 1000, T);
+  uint64_t max_hi = 0xffffffffffffull << 16, far_hi = (T + 864000000) << 16;
+  std::vector<uint64_t> batch(words.begin(), words.begin() + 10);
+  batch.insert(batch.end(), {max_hi, 1, 0, 2, far_hi, 3});
+  batch.insert(batch.end(), words.begin() + 10, words.begin() + 20);
+  batch.insert(batch.end(), words.begin() + 10, words.begin() + 12);
+
+  Deduplicator dedup(2);
+  dedup.feed_words(batch.data(), batch.size() / 2);
+  assert(dedup.outlier_count() == 3);
+  assert(dedup.duplicate_count() == 1 && dedup.late_count() == 0);
+  assert(dedup.duplicates()[0].hi == words[10]);
+
+  // a stream resuming after a long gap moves the window once confirmed
+  std::vector<uint64_t> later;
+  generate_words(later, 1, 100, T + 86400000);
+  dedup.feed_words(later.data(), later.size() / 2);
+  assert(dedup.outlier_count() == 3 + 15);
+  dedup.feed_words(words.data(), words.size() / 2);
+  assert(dedup.late_count() == words.size() / 2);
+  dedup.feed_words(later.data() + 40, 1);
+  assert(dedup.duplicate_count() == 2);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Measures throughput with 1-8 shards over batches of a million IDs from 1000
+ * generators producing one ID per millisecond each for 10 seconds, merged in
+ * order of `timestamp` as an aggregated stream would be.
+ */
+static void run_benchmarks(void) {
+  std::vector<uint64_t> words;
+  generate_words(words, 1000, 10000, T, 1);
+  const size_t BATCH = 1000000;
+  size_t n = words.size() / 2;
+  std::vector<std::pair<uint64_t, uint64_t>> pairs(n);
+  for (size_t i = 0; i < n; i++) {
+    pairs[i] = {words[2 * i], words[2 * i + 1]};
+  }
+  std::stable_sort(pairs.begin(), pairs.end(), [](auto &a, auto &b) {
+    return a.first >> 16 < b.first >> 16;
+  });
+  for (size_t i = 0; i < n; i++) {
+    words[2 * i] = pairs[i].first;
+    words[2 * i + 1] = pairs[i].second;
+  }
+
+  for (unsigned n_shards = 1; n_shards <= 8; n_shards *= 2) {
+    Deduplicator dedup(n_shards);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < n; i += BATCH) {
+      dedup.feed_words(words.data() + 2 * i, n - i < BATCH ? n - i : BATCH);
+    }
+    double elapsed = (double)(now_ns() - start);
+    printf("%u shards: %6.2f ns/id  %7.2f MB of sets  (%llu)\n", n_shards,
+           elapsed / n, dedup.memory_bytes() / 1e6,
+           (unsigned long long)dedup.duplicate_count());
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_id_set();
+  test_distinct_generators();
+  test_injected_duplicates();
+  test_window();
+  test_long_batch();
+  test_outliers();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,183 @@
+/** fields.hpp - Batch conversion between binary IDs and per-field arrays
+ *
+ * Converts arrays of 16-byte binary IDs into four separate arrays of
+ * `timestamp`, `counter_hi`, `counter_lo`, and `entropy` values (a
+ * struct-of-arrays layout for columnar engines) and back. When compiled for
+ * SSSE3 (e.g., with `-mssse3` or `-march=native`), the big-endian fields are
+ * extracted and assembled four IDs at a time with byte shuffles; otherwise,
+ * and for the last few IDs of an array, the portable scalar versions run.
+ */
+
+#ifndef SCRU128_FIELDS_HPP
+#define SCRU128_FIELDS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace scru128 {
+
+/**
+ * Splits `n` binary IDs into per-field arrays, one ID at a time.
+ *
+ * @param ids `n` * 16-byte byte array
+ * @param n number of IDs
+ * @param timestamp receives `n` 48-bit `timestamp` values
+ * @param counter_hi receives `n` 24-bit `counter_hi` values
+ * @param counter_lo receives `n` 24-bit `counter_lo` values
+ * @param entropy receives `n` 32-bit `entropy` values
+ */
+inline void split_fields_scalar(const uint8_t *ids, size_t n,
+                                uint64_t *timestamp, uint32_t *counter_hi,
+                                uint32_t *counter_lo, uint32_t *entropy) {
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t *id = ids + 16 * i;
+    timestamp[i] = (uint64_t)id[0] << 40 | (uint64_t)id[1] << 32 |
+                   (uint64_t)id[2] << 24 | (uint64_t)id[3] << 16 |
+                   (uint64_t)id[4] << 8 | id[5];
+    counter_hi[i] = (uint32_t)id[6] << 16 | (uint32_t)id[7] << 8 | id[8];
+    counter_lo[i] = (uint32_t)id[9] << 16 | (uint32_t)id[10] << 8 | id[11];
+    entropy[i] = (uint32_t)id[12] << 24 | (uint32_t)id[13] << 16 |
+                 (uint32_t)id[14] << 8 | id[15];
+  }
+}
+
+/**
+ * Joins per-field arrays into `n` binary IDs, one ID at a time. Each field is
+ * truncated to its width.
+ *
+ * @param timestamp `n` `timestamp` values
+ * @param counter_hi `n` `counter_hi` values
+ * @param counter_lo `n` `counter_lo` values
+ * @param entropy `n` `entropy` values
+ * @param n number of IDs
+ * @param ids `n` * 16-byte byte array that receives the IDs
+ */
+inline void join_fields_scalar(const uint64_t *timestamp,
+                               const uint32_t *counter_hi,
+                               const uint32_t *counter_lo,
+                               const uint32_t *entropy, size_t n,
+                               uint8_t *ids) {
+  for (size_t i = 0; i < n; i++) {
+    uint8_t *id = ids + 16 * i;
+    for (int j = 0; j < 6; j++) {
+      id[j] = (uint8_t)(timestamp[i] >> (40 - 8 * j));
+    }
+    for (int j = 0; j < 3; j++) {
+      id[6 + j] = (uint8_t)(counter_hi[i] >> (16 - 8 * j));
+      id[9 + j] = (uint8_t)(counter_lo[i] >> (16 - 8 * j));
+    }
+    for (int j = 0; j < 4; j++) {
+      id[12 + j] = (uint8_t)(entropy[i] >> (24 - 8 * j));
+    }
+  }
+}
+
+/**
+ * Splits `n` binary IDs into per-field arrays. See `split_fields_scalar()`
+ * for the parameters; the arrays need no particular alignment.
+ */
+inline void split_fields(const uint8_t *ids, size_t n, uint64_t *timestamp,
+                         uint32_t *counter_hi, uint32_t *counter_lo,
+                         uint32_t *entropy) {
+  size_t i = 0;
+#ifdef __SSSE3__
+  // byte-reverse `timestamp` into the low 64 bits, zero-extended
+  const __m128i TIMESTAMP = _mm_setr_epi8(5, 4, 3, 2, 1, 0, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1);
+  // byte-reverse the other fields into three 32-bit lanes
+  const __m128i COUNTERS = _mm_setr_epi8(8, 7, 6, -1, 11, 10, 9, -1, 15, 14,
+                                         13, 12, -1, -1, -1, -1);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i *src = (const __m128i *)(ids + 16 * i);
+    __m128i a = _mm_loadu_si128(src);
+    __m128i b = _mm_loadu_si128(src + 1);
+    __m128i c = _mm_loadu_si128(src + 2);
+    __m128i d = _mm_loadu_si128(src + 3);
+
+    __m128i *ts = (__m128i *)(timestamp + i);
+    _mm_storeu_si128(ts, _mm_unpacklo_epi64(_mm_shuffle_epi8(a, TIMESTAMP),
+                                            _mm_shuffle_epi8(b, TIMESTAMP)));
+    _mm_storeu_si128(ts + 1, _mm_unpacklo_epi64(_mm_shuffle_epi8(c, TIMESTAMP),
+                                                _mm_shuffle_epi8(d, TIMESTAMP)));
+
+    // transpose the rows {counter_hi, counter_lo, entropy, 0} of four IDs
+    a = _mm_shuffle_epi8(a, COUNTERS);
+    b = _mm_shuffle_epi8(b, COUNTERS);
+    c = _mm_shuffle_epi8(c, COUNTERS);
+    d = _mm_shuffle_epi8(d, COUNTERS);
+    __m128i ab_lo = _mm_unpacklo_epi32(a, b);
+    __m128i cd_lo = _mm_unpacklo_epi32(c, d);
+    __m128i ab_hi = _mm_unpackhi_epi32(a, b);
+    __m128i cd_hi = _mm_unpackhi_epi32(c, d);
+    _mm_storeu_si128((__m128i *)(counter_hi + i),
+                     _mm_unpacklo_epi64(ab_lo, cd_lo));
+    _mm_storeu_si128((__m128i *)(counter_lo + i),
+                     _mm_unpackhi_epi64(ab_lo, cd_lo));
+    _mm_storeu_si128((__m128i *)(entropy + i),
+                     _mm_unpacklo_epi64(ab_hi, cd_hi));
+  }
+#endif /* #ifdef __SSSE3__ */
+  split_fields_scalar(ids + 16 * i, n - i, timestamp + i, counter_hi + i,
+                      counter_lo + i, entropy + i);
+}
+
+/**
+ * Joins per-field arrays into `n` binary IDs. See `join_fields_scalar()` for
+ * the parameters; the arrays need no particular alignment.
+ */
+inline void join_fields(const uint64_t *timestamp, const uint32_t *counter_hi,
+                        const uint32_t *counter_lo, const uint32_t *entropy,
+                        size_t n, uint8_t *ids) {
+  size_t i = 0;
+#ifdef __SSSE3__
+  // place the low 48 bits of the first or second 64-bit lane in big-endian
+  const __m128i TIMESTAMP_0 = _mm_setr_epi8(5, 4, 3, 2, 1, 0, -1, -1, -1, -1,
+                                            -1, -1, -1, -1, -1, -1);
+  const __m128i TIMESTAMP_1 = _mm_setr_epi8(13, 12, 11, 10, 9, 8, -1, -1, -1,
+                                            -1, -1, -1, -1, -1, -1, -1);
+  // place the low 24, 24, and 32 bits of three 32-bit lanes in big-endian
+  const __m128i COUNTERS = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 1, 0, 6, 5,
+                                         4, 11, 10, 9, 8);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i *ts = (const __m128i *)(timestamp + i);
+    __m128i ts_ab = _mm_loadu_si128(ts);
+    __m128i ts_cd = _mm_loadu_si128(ts + 1);
+    __m128i ch = _mm_loadu_si128((const __m128i *)(counter_hi + i));
+    __m128i cl = _mm_loadu_si128((const __m128i *)(counter_lo + i));
+    __m128i e = _mm_loadu_si128((const __m128i *)(entropy + i));
+
+    // transpose the columns back into rows {counter_hi, counter_lo, entropy}
+    __m128i ab = _mm_unpacklo_epi32(ch, cl);
+    __m128i cd = _mm_unpackhi_epi32(ch, cl);
+    __m128i e_ab = _mm_unpacklo_epi32(e, e);
+    __m128i e_cd = _mm_unpackhi_epi32(e, e);
+    __m128i a = _mm_unpacklo_epi64(ab, e_ab);
+    __m128i b = _mm_unpackhi_epi64(ab, e_ab);
+    __m128i c = _mm_unpacklo_epi64(cd, e_cd);
+    __m128i d = _mm_unpackhi_epi64(cd, e_cd);
+
+    __m128i *dst = (__m128i *)(ids + 16 * i);
+    _mm_storeu_si128(dst, _mm_or_si128(_mm_shuffle_epi8(ts_ab, TIMESTAMP_0),
+                                       _mm_shuffle_epi8(a, COUNTERS)));
+    _mm_storeu_si128(dst + 1,
+                     _mm_or_si128(_mm_shuffle_epi8(ts_ab, TIMESTAMP_1),
+                                  _mm_shuffle_epi8(b, COUNTERS)));
+    _mm_storeu_si128(dst + 2,
+                     _mm_or_si128(_mm_shuffle_epi8(ts_cd, TIMESTAMP_0),
+                                  _mm_shuffle_epi8(c, COUNTERS)));
+    _mm_storeu_si128(dst + 3,
+                     _mm_or_si128(_mm_shuffle_epi8(ts_cd, TIMESTAMP_1),
+                                  _mm_shuffle_epi8(d, COUNTERS)));
+  }
+#endif /* #ifdef __SSSE3__ */
+  join_fields_scalar(timestamp + i, counter_hi + i, counter_lo + i,
+                     entropy + i, n - i, ids + 16 * i);
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_FIELDS_HPP */
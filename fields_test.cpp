@@ -0,0 +1,113 @@
+/** fields_test.cpp - Tests for fields.hpp
+ *
+ * Compile with and without `-mssse3` to test both the vector and the scalar
+ * paths.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "fields.hpp"
+#include "id.hpp"
+#include "random.hpp"
+
+using namespace scru128;
+
+/** Fills `ids` with random bytes. */
+static void fill_random(std::vector<uint8_t> &ids, uint64_t seed) {
+  WyrandRandom rng(seed);
+  for (size_t i = 0; i < ids.size(); i += 8) {
+    uint64_t r = rng.next_u64();
+    memcpy(&ids[i], &r, 8);
+  }
+}
+
+/** Splits IDs into fields that match the accessors of `Id`. */
+static void test_split(void) {
+  for (size_t n : {0, 1, 3, 4, 5, 8, 1003}) {
+    std::vector<uint8_t> ids(16 * n);
+    fill_random(ids, n);
+    std::vector<uint64_t> ts(n);
+    std::vector<uint32_t> ch(n), cl(n), e(n);
+    split_fields(ids.data(), n, ts.data(), ch.data(), cl.data(), e.data());
+    for (size_t i = 0; i < n; i++) {
+      Id id = Id::from_bytes(&ids[16 * i]);
+      assert(ts[i] == id.timestamp());
+      assert(ch[i] == id.counter_hi());
+      assert(cl[i] == id.counter_lo());
+      assert(e[i] == id.entropy());
+    }
+  }
+}
+
+/** Joins fields into the IDs they were split from, truncating wide values. */
+static void test_join(void) {
+  const size_t n = 1003;
+  std::vector<uint8_t> ids(16 * n), joined(16 * n), scalar(16 * n);
+  fill_random(ids, 42);
+  std::vector<uint64_t> ts(n);
+  std::vector<uint32_t> ch(n), cl(n), e(n);
+  split_fields(ids.data(), n, ts.data(), ch.data(), cl.data(), e.data());
+  join_fields(ts.data(), ch.data(), cl.data(), e.data(), n, joined.data());
+  assert(joined == ids);
+
+  for (size_t i = 0; i < n; i++) {
+    ts[i] |= (uint64_t)0xabcd << 48;
+    ch[i] |= 0xef000000;
+    cl[i] |= 0x12000000;
+  }
+  join_fields(ts.data(), ch.data(), cl.data(), e.data(), n, joined.data());
+  join_fields_scalar(ts.data(), ch.data(), cl.data(), e.data(), n,
+                     scalar.data());
+  assert(joined == ids && scalar == ids);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Compares the scalar and dispatched versions over 4 million IDs. */
+static void run_benchmarks(void) {
+  const size_t N = 4000000;
+  std::vector<uint8_t> ids(16 * N);
+  fill_random(ids, 1);
+  std::vector<uint64_t> ts(N);
+  std::vector<uint32_t> ch(N), cl(N), e(N);
+
+  uint64_t start = now_ns();
+  split_fields_scalar(ids.data(), N, ts.data(), ch.data(), cl.data(),
+                      e.data());
+  double split_scalar_ns = (double)(now_ns() - start) / N;
+  start = now_ns();
+  split_fields(ids.data(), N, ts.data(), ch.data(), cl.data(), e.data());
+  double split_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  join_fields_scalar(ts.data(), ch.data(), cl.data(), e.data(), N,
+                     ids.data());
+  double join_scalar_ns = (double)(now_ns() - start) / N;
+  start = now_ns();
+  join_fields(ts.data(), ch.data(), cl.data(), e.data(), N, ids.data());
+  double join_ns = (double)(now_ns() - start) / N;
+
+  printf("split scalar: %5.2f ns/id  split: %5.2f ns/id  "
+         "join scalar: %5.2f ns/id  join: %5.2f ns/id\n",
+         split_scalar_ns, split_ns, join_scalar_ns, join_ns);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_split();
+  test_join();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
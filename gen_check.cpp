@@ -0,0 +1,172 @@
+/** gen_check.cpp - Checks a stream of generated IDs for conformance
+ *
+ * Usage: gen_check [-b] [-t reference_ms] [-w tolerance_ms] [file]
+ *
+ * Reads text IDs (one per line) or, with `-b`, 16-byte binary IDs from `file`,
+ * which is memory-mapped, or from the standard input, and validates them with
+ * `Checker` (see `checker.hpp`). The reference time defaults to the current
+ * time; pass the time at which a sample was recorded with `-t` and its
+ * duration with `-w` to check archived output. Exits with status 1 if any
+ * violation is found.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checker.hpp"
+
+using namespace scru128;
+
+static const size_t CHUNK_SIZE = 1 << 20;
+
+/** Feeds `len` bytes of `buf` and returns the number of bytes consumed. */
+static size_t feed(Checker &checker, bool binary, const char *buf,
+                   size_t len) {
+  if (binary) {
+    checker.feed_binary((const uint8_t *)buf, len / 16);
+    return len / 16 * 16;
+  }
+  return checker.feed_text(buf, len);
+}
+
+/** Checks the trailing bytes that do not form a complete record. */
+static void feed_rest(Checker &checker, bool binary, const char *buf,
+                      size_t len) {
+  if (len > 0) {
+    if (binary) {
+      fprintf(stderr, "gen_check: ignored %zu trailing bytes\n", len);
+    } else {
+      checker.check_text(buf, len);
+    }
+  }
+}
+
+static int check_file(Checker &checker, bool binary, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+  size_t len = (size_t)st.st_size;
+  if (len > 0) {
+    void *addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      perror(path);
+      close(fd);
+      return -1;
+    }
+    madvise(addr, len, MADV_SEQUENTIAL);
+    size_t pos = feed(checker, binary, (const char *)addr, len);
+    feed_rest(checker, binary, (const char *)addr + pos, len - pos);
+    munmap(addr, len);
+  }
+  close(fd);
+  return 0;
+}
+
+static int check_stdin(Checker &checker, bool binary) {
+  char *buf = (char *)malloc(CHUNK_SIZE);
+  size_t len = 0; // bytes held in `buf`, starting with an incomplete record
+  bool skipping = false; // within a line longer than `CHUNK_SIZE`
+  for (;;) {
+    ssize_t n = read(STDIN_FILENO, buf + len, CHUNK_SIZE - len);
+    if (n < 0) {
+      perror("stdin");
+      free(buf);
+      return -1;
+    } else if (n == 0) {
+      break;
+    }
+    len += (size_t)n;
+    size_t pos = 0;
+    if (skipping) {
+      const char *eol = (const char *)memchr(buf, '\n', len);
+      skipping = eol == nullptr;
+      pos = skipping ? len : (size_t)(eol - buf) + 1;
+    }
+    pos += feed(checker, binary, buf + pos, len - pos);
+    if (pos == 0 && len == CHUNK_SIZE) {
+      // count an overlong line as an invalid record and skip the rest of it
+      checker.check_text(buf, len);
+      skipping = true;
+      pos = len;
+    }
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
+  }
+  feed_rest(checker, binary, buf, len);
+  free(buf);
+  return 0;
+}
+
+static void print_report(Checker &checker) {
+  const CheckReport &r = checker.report();
+  printf("records:                %llu\n", (unsigned long long)r.records);
+  printf("invalid:                %llu\n", (unsigned long long)r.invalid);
+  printf("out of order:           %llu\n", (unsigned long long)r.out_of_order);
+  printf("timestamp out of range: %llu\n",
+         (unsigned long long)r.timestamp_out_of_range);
+  printf("counter_lo errors:      %llu\n",
+         (unsigned long long)r.counter_lo_errors);
+  printf("stale counter_lo:       %llu of %llu new timestamps (limit %llu)\n",
+         (unsigned long long)r.stale_counters,
+         (unsigned long long)r.new_timestamps,
+         (unsigned long long)r.max_stale_counters);
+  printf("counter_hi renewals:    %llu (early %llu, missed %llu)\n",
+         (unsigned long long)r.counter_hi_renewals,
+         (unsigned long long)r.early_renewals,
+         (unsigned long long)r.missed_renewals);
+  printf("entropy bit balance:    max |z| %.2f (%llu bits over %.1f)\n",
+         r.max_entropy_z, (unsigned long long)r.unbalanced_bits,
+         checker.options().max_entropy_z);
+  printf("bit balance z-scores (most significant first):\n");
+  for (int bit = 0; bit < 128; bit++) {
+    printf("%9.2f%c", checker.bit_z_score(bit), bit % 8 == 7 ? '\n' : ' ');
+  }
+  printf("%s\n", r.passed() ? "PASS" : "FAIL");
+}
+
+int main(int argc, char *argv[]) {
+  bool binary = false;
+  CheckerOptions options;
+  int opt;
+  while ((opt = getopt(argc, argv, "bt:w:")) != -1) {
+    switch (opt) {
+    case 'b':
+      binary = true;
+      break;
+    case 't':
+      options.reference_ms = strtoull(optarg, nullptr, 10);
+      break;
+    case 'w':
+      options.tolerance_ms = strtoull(optarg, nullptr, 10);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-b] [-t reference_ms] [-w tolerance_ms] [file]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  Checker checker(options);
+  int err = optind < argc ? check_file(checker, binary, argv[optind])
+                          : check_stdin(checker, binary);
+  if (err != 0) {
+    return 2;
+  }
+  print_report(checker);
+  return checker.report().passed() ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/** gen_dedup.cpp - Finds duplicate IDs in a stream aggregated from many nodes
+ *
+ * Usage: gen_dedup [-b] [-w window_sec] [-j threads] [file]
+ *
+ * Reads text IDs (one per line) or, with `-b`, 16-byte binary IDs from `file`
+ * or from the standard input, checks them with `Deduplicator` (see
+ * `dedup.hpp`), and prints the duplicates found to the standard output and a
+ * summary to the standard error. IDs that arrive more than `window_sec`
+ * seconds behind the newest one cannot be checked and are only counted, as
+ * are IDs with a reserved timestamp or far ahead of the rest of the stream.
+ * Lines that are not a valid ID, however long, are skipped and counted as
+ * invalid. Exits with status 1 if any duplicate is found.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "codec.hpp"
+#include "dedup.hpp"
+
+using namespace scru128;
+
+static const size_t BATCH_SIZE = 1 << 20;
+static const size_t CHUNK_SIZE = 1 << 20;
+
+/** Longest valid line without its newline: 25 digits and CR. */
+static const size_t MAX_LINE = 26;
+
+/** Reads IDs in chunks and feeds them to a deduplicator in batches. */
+class Reader {
+ public:
+  Reader(Deduplicator &dedup, bool binary) : dedup_(dedup), binary_(binary) {
+    words_.reserve(2 * BATCH_SIZE);
+  }
+
+  /** Reads `fd` to the end and returns zero on success. */
+  int read_all(int fd) {
+    std::vector<char> buf(CHUNK_SIZE);
+    size_t len = 0; // bytes held in `buf`, starting with an incomplete record
+    for (;;) {
+      ssize_t n = read(fd, buf.data() + len, buf.size() - len);
+      if (n < 0) {
+        return -1;
+      } else if (n == 0) {
+        break;
+      }
+      len += (size_t)n;
+      size_t pos = binary_ ? parse_binary(buf.data(), len)
+                           : parse_text(buf.data(), len);
+      if (!binary_ && len - pos > MAX_LINE) {
+        // drop an overlong line up to its newline, which may be far ahead
+        if (!skipping_) {
+          invalid_++;
+          skipping_ = true;
+        }
+        pos = len;
+      }
+      memmove(buf.data(), buf.data() + pos, len - pos);
+      len -= pos;
+    }
+    if (len > 0 && !binary_ && !skipping_) {
+      add_text(buf.data(), len);
+    }
+    flush();
+    return 0;
+  }
+
+  /** Returns the number of records that could not be decoded. */
+  uint64_t invalid() const { return invalid_; }
+
+ private:
+  size_t parse_binary(const char *buf, size_t len) {
+    size_t n = len / 16;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t hi = 0, lo = 0;
+      for (int j = 0; j < 8; j++) {
+        hi = hi << 8 | (uint8_t)buf[16 * i + j];
+        lo = lo << 8 | (uint8_t)buf[16 * i + j + 8];
+      }
+      add(hi, lo);
+    }
+    return 16 * n;
+  }
+
+  size_t parse_text(const char *buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+      const char *eol = (const char *)memchr(buf + pos, '\n', len - pos);
+      if (eol == nullptr) {
+        break;
+      }
+      if (skipping_) {
+        skipping_ = false; // the rest of a line already counted as invalid
+      } else {
+        add_text(buf + pos, (size_t)(eol - (buf + pos)));
+      }
+      pos = (size_t)(eol - buf) + 1;
+    }
+    return pos;
+  }
+
+  void add_text(const char *record, size_t len) {
+    uint64_t hi, lo;
+    if (len > 0 && record[len - 1] == '\r') {
+      len--;
+    }
+    if (len != 25 || decode_words(record, &hi, &lo) != 0) {
+      invalid_++;
+      return;
+    }
+    add(hi, lo);
+  }
+
+  void add(uint64_t hi, uint64_t lo) {
+    words_.push_back(hi);
+    words_.push_back(lo);
+    if (words_.size() == 2 * BATCH_SIZE) {
+      flush();
+    }
+  }
+
+  void flush() {
+    dedup_.feed_words(words_.data(), words_.size() / 2);
+    words_.clear();
+  }
+
+  Deduplicator &dedup_;
+  bool binary_;
+  std::vector<uint64_t> words_;
+  uint64_t invalid_ = 0;
+  bool skipping_ = false; // within a line longer than `MAX_LINE`
+};
+
+int main(int argc, char *argv[]) {
+  bool binary = false;
+  uint64_t window_sec = 10;
+  unsigned threads = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "bw:j:")) != -1) {
+    switch (opt) {
+    case 'b':
+      binary = true;
+      break;
+    case 'w':
+      window_sec = strtoull(optarg, nullptr, 10);
+      break;
+    case 'j':
+      threads = (unsigned)atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-b] [-w window_sec] [-j threads] [file]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  int fd = STDIN_FILENO;
+  if (optind < argc && (fd = open(argv[optind], O_RDONLY)) < 0) {
+    perror(argv[optind]);
+    return 2;
+  }
+  Deduplicator dedup(threads, window_sec, 1000000);
+  Reader reader(dedup, binary);
+  if (reader.read_all(fd) != 0) {
+    perror("read");
+    return 2;
+  }
+
+  for (const Deduplicator::Duplicate &d : dedup.duplicates()) {
+    char text[26];
+    encode_words(d.hi, d.lo, text);
+    text[25] = '\0';
+    puts(text);
+  }
+  fprintf(stderr,
+          "ids %llu  invalid %llu  duplicates %llu  late %llu  outliers %llu  "
+          "peak set memory %.1f MB\n",
+          (unsigned long long)dedup.ids(), (unsigned long long)reader.invalid(),
+          (unsigned long long)dedup.duplicate_count(),
+          (unsigned long long)dedup.late_count(),
+          (unsigned long long)dedup.outlier_count(),
+          dedup.memory_bytes() / 1e6);
+  return dedup.duplicate_count() > 0 ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+/** gen_merge.cpp - Merges sorted ID files collected from many nodes
+ *
+ * Usage: gen_merge [-b] [-u] file...
+ *
+ * Reads text IDs (one per line) or, with `-b`, 16-byte binary IDs from each
+ * `file`, which must be sorted, merges them with `StreamMerger` (see
+ * `merge.hpp`) into the standard output in the same format, and prints a
+ * summary to the standard error. With `-u`, duplicate IDs are written only
+ * once. Exits with status 1 if any input is out of order.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "merge.hpp"
+
+using namespace scru128;
+
+int main(int argc, char *argv[]) {
+  bool binary = false, dedup = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "bu")) != -1) {
+    switch (opt) {
+    case 'b':
+      binary = true;
+      break;
+    case 'u':
+      dedup = true;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-b] [-u] file...\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<FdSource> sources;
+  for (int i = optind; i < argc; i++) {
+    int fd = open(argv[i], O_RDONLY);
+    if (fd < 0) {
+      perror(argv[i]);
+      return 2;
+    }
+    sources.emplace_back(fd, binary);
+  }
+  StreamMerger merger(dedup, 4096);
+  FdSink sink(STDOUT_FILENO, binary);
+  if (merger.merge(sources.data(), sources.size(), sink) != 0) {
+    perror("merge");
+    return 2;
+  }
+
+  uint64_t invalid = 0;
+  for (const FdSource &source : sources) {
+    invalid += source.invalid();
+  }
+  fprintf(stderr, "ids %llu  invalid %llu  duplicates %llu  unordered %llu\n",
+          (unsigned long long)merger.ids(), (unsigned long long)invalid,
+          (unsigned long long)merger.duplicate_count(),
+          (unsigned long long)merger.unordered_count());
+  return merger.unordered_count() > 0 ? 1 : 0;
+}
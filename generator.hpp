@@ -0,0 +1,469 @@
+/** generator.hpp - Reference SCRU128 generator */
+
+#ifndef SCRU128_GENERATOR_HPP
+#define SCRU128_GENERATOR_HPP
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "clock.hpp"
+#include "codec.hpp"
+#include "id.hpp"
+#include "probes.h"
+#include "random.hpp"
+
+namespace scru128 {
+
+/** Maximum value of 24-bit `counter_hi` field. */
+constexpr uint32_t MAX_COUNTER_HI = 0xffffff;
+
+/** Maximum value of 24-bit `counter_lo` field. */
+constexpr uint32_t MAX_COUNTER_LO = 0xffffff;
+
+/** Default rollback allowance in milliseconds (see `GeneratorPolicy`). */
+constexpr uint64_t DEFAULT_ROLLBACK_ALLOWANCE = 10000;
+
+/** Treatment of a clock rollback greater than the rollback allowance. */
+enum class RollbackAction {
+  /** Resets the state as if a new generator were created. */
+  RESET,
+  /** Fails to generate an ID until the clock catches up. */
+  ABORT,
+};
+
+/** Counter overflow and clock rollback handling configuration. */
+struct GeneratorPolicy {
+  /**
+   * Maximum clock rollback in milliseconds that is absorbed by reusing the
+   * last `timestamp`. This also bounds how far `timestamp` may run ahead of
+   * the wall clock after counter overflows before `on_large_rollback` applies.
+   */
+  uint64_t rollback_allowance = DEFAULT_ROLLBACK_ALLOWANCE;
+
+  /** Treatment of a clock rollback greater than `rollback_allowance`. */
+  RollbackAction on_large_rollback = RollbackAction::RESET;
+};
+
+/**
+ * Counters that record how often a generator has taken the counter overflow
+ * and clock rollback handling paths.
+ *
+ * A generator keeps the counters as plain integers, so that it stays a
+ * copyable value type, and updates them with relaxed atomic stores through
+ * `std::atomic_ref` from the generator thread only, which costs the same as
+ * plain stores. `snapshot()` reads them the same way from any thread (e.g., a
+ * metrics exporter) without locking.
+ */
+struct GeneratorStats {
+  /** Number of times `timestamp` was incremented on counter overflow. */
+  uint64_t counter_overflows = 0;
+
+  /** Number of clock rollbacks absorbed by reusing the last `timestamp`. */
+  uint64_t tolerated_rollbacks = 0;
+
+  /** Number of resets on large clock rollbacks. */
+  uint64_t resets = 0;
+
+  /** Number of failures on large clock rollbacks. */
+  uint64_t aborts = 0;
+
+  /**
+   * `timestamp` of the last generated ID minus the clock reading, in
+   * milliseconds. A positive value means that generation is running ahead of
+   * the wall clock, typically after counter overflows under burst load.
+   */
+  int64_t timestamp_lead_ms = 0;
+
+  /** Maximum of `timestamp_lead_ms` observed so far. */
+  int64_t max_timestamp_lead_ms = 0;
+
+  /** Returns a copy of the counters read with relaxed atomic loads. */
+  GeneratorStats snapshot() const {
+    GeneratorStats copy;
+    copy.counter_overflows = load(counter_overflows);
+    copy.tolerated_rollbacks = load(tolerated_rollbacks);
+    copy.resets = load(resets);
+    copy.aborts = load(aborts);
+    copy.timestamp_lead_ms = load(timestamp_lead_ms);
+    copy.max_timestamp_lead_ms = load(max_timestamp_lead_ms);
+    return copy;
+  }
+
+  /** Increments a counter from the single writer thread. */
+  static void increment(uint64_t &counter) {
+    store(counter, counter + 1);
+  }
+
+  /** Records the lead of `timestamp` over a clock reading. */
+  void record_lead(uint64_t timestamp, uint64_t unix_ts_ms) {
+    int64_t lead = (int64_t)(timestamp - unix_ts_ms);
+    store(timestamp_lead_ms, lead);
+    if (lead > max_timestamp_lead_ms) {
+      store(max_timestamp_lead_ms, lead);
+    }
+  }
+
+ private:
+  template <class T> static T load(const T &value) {
+    return std::atomic_ref<T>(const_cast<T &>(value))
+        .load(std::memory_order_relaxed);
+  }
+
+  template <class T> static void store(T &value, T desired) {
+    std::atomic_ref<T>(value).store(desired, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * Writes the four fields into a 16-byte byte array in the big-endian layout
+ * described in the specification.
+ */
+inline void store_id(uint8_t *out, uint64_t timestamp, uint32_t counter_hi,
+                     uint32_t counter_lo, uint32_t entropy) {
+  out[0] = timestamp >> 40;
+  out[1] = timestamp >> 32;
+  out[2] = timestamp >> 24;
+  out[3] = timestamp >> 16;
+  out[4] = timestamp >> 8;
+  out[5] = timestamp;
+  out[6] = counter_hi >> 16;
+  out[7] = counter_hi >> 8;
+  out[8] = counter_hi;
+  out[9] = counter_lo >> 16;
+  out[10] = counter_lo >> 8;
+  out[11] = counter_lo;
+  out[12] = entropy >> 24;
+  out[13] = entropy >> 16;
+  out[14] = entropy >> 8;
+  out[15] = entropy;
+}
+
+/**
+ * Generates monotonically ordered SCRU128 IDs.
+ *
+ * The generator reads the current time from `Clock` (see `clock.hpp` for the
+ * available sources and their cost) and random numbers from `Random` through
+ * an `EntropyPool`. It follows the counter overflow handling and clock
+ * rollback handling rules of the specification: a rollback not greater than
+ * the rollback allowance is absorbed by reusing the last `timestamp`, while a
+ * larger rollback resets the generator state as if a new generator were
+ * created or makes the generation fail, depending on `GeneratorPolicy`. The
+ * paths taken are recorded in `GeneratorStats`.
+ *
+ * An instance is not thread-safe, except that `stats()` may be called from
+ * other threads.
+ */
+template <class Clock = RealtimeClock, class Random = SystemRandom>
+class Generator {
+ public:
+  explicit Generator(Clock clock = Clock(), Random random = Random(),
+                     GeneratorPolicy policy = GeneratorPolicy())
+      : clock_(clock), pool_(random), policy_(policy) {}
+
+  /**
+   * Generates a new ID.
+   *
+   * @param out 16-byte byte array
+   * @return zero on success or non-zero if the clock has moved back by more
+   * than the rollback allowance and the policy is `RollbackAction::ABORT`
+   */
+  int generate(uint8_t *out) {
+    if (advance(clock_.now_ms()) != 0) {
+      return -1;
+    }
+    store_id(out, timestamp_, counter_hi_, counter_lo_, pool_.next_u32());
+    return 0;
+  }
+
+  /**
+   * Generates a new ID in the native representation, without byte swaps.
+   *
+   * @param out receives the ID
+   * @return zero on success or non-zero on failure as `generate(uint8_t *)`
+   */
+  int generate(Id *out) {
+    if (advance(clock_.now_ms()) != 0) {
+      return -1;
+    }
+    *out = Id::from_fields(timestamp_, counter_hi_, counter_lo_,
+                           pool_.next_u32());
+    return 0;
+  }
+
+  /**
+   * Generates `n` new IDs at once.
+   *
+   * This function reads the clock only once and assigns a contiguous run of
+   * `counter_lo` values to the batch, carrying into `counter_hi` and, on
+   * counter overflow, into `timestamp` as `generate()` would do if it were
+   * called `n` times within the same millisecond. The `entropy` fields of the
+   * whole batch are drawn in a single call to the random source; they are
+   * staged in the tail of `out`, which each ID overwrites only after all the
+   * staged values up to its own have been consumed.
+   *
+   * @param n number of IDs to generate
+   * @param out `n` * 16-byte byte array
+   * @param text_out `n` * 26-byte character array that receives the textual
+   * representations (25 digits and terminating NUL each), or `nullptr`
+   * @return zero on success or non-zero on failure as `generate()`
+   */
+  int generate_many(size_t n, uint8_t *out, char *text_out = nullptr) {
+    if (n == 0) {
+      return 0;
+    }
+    uint8_t *staged = out + 12 * n;
+    pool_.fill(staged, 4 * n);
+    return reserve_run(n, [&](size_t i) {
+      uint32_t entropy;
+      memcpy(&entropy, staged + 4 * i, 4);
+      store_id(out + 16 * i, timestamp_, counter_hi_, counter_lo_, entropy);
+      if (text_out != nullptr) {
+        encode_words(timestamp_ << 16 | counter_hi_ >> 8,
+                     (uint64_t)counter_hi_ << 56 | (uint64_t)counter_lo_ << 32 |
+                         entropy,
+                     text_out + 26 * i);
+        text_out[26 * i + 25] = '\0';
+      }
+    });
+  }
+
+  /**
+   * Generates up to `n` new IDs and writes their textual representations
+   * directly into `buf` as 26-byte records of 25 digits followed by `delim`.
+   *
+   * This function fuses `generate_many()` and encoding: each ID is encoded
+   * from the generator state held in registers, without materializing the
+   * 16-byte binary form, and `entropy` is drawn from the in-cache entropy
+   * pool. The number of IDs generated is limited by `buf_len` so that a
+   * caller can fill fixed-size output buffers and pass them to `write()` or
+   * `writev()` as they are.
+   *
+   * @param n number of IDs to generate
+   * @param buf output buffer
+   * @param buf_len size of `buf` in bytes
+   * @param delim record delimiter
+   * @return number of bytes written (a multiple of 26), or zero on failure as
+   * `generate()`
+   */
+  size_t generate_text(size_t n, char *buf, size_t buf_len,
+                       char delim = '\n') {
+    if (n > buf_len / 26) {
+      n = buf_len / 26;
+    }
+    if (n == 0) {
+      return 0;
+    }
+    int err = reserve_run(n, [&](size_t i) {
+      char *record = buf + 26 * i;
+      encode_words(timestamp_ << 16 | counter_hi_ >> 8,
+                   (uint64_t)counter_hi_ << 56 | (uint64_t)counter_lo_ << 32 |
+                       pool_.next_u32(),
+                   record);
+      record[25] = delim;
+    });
+    return err == 0 ? 26 * n : 0;
+  }
+
+  /**
+   * Restores the state as if the last ID had been generated at `unix_ts_ms`,
+   * so that subsequent IDs have `timestamp` not less than `unix_ts_ms` unless
+   * the clock is behind it by more than the rollback allowance.
+   *
+   * This is used to carry monotonicity over a restart (see
+   * `persistent_generator.hpp`).
+   */
+  void resume_from(uint64_t unix_ts_ms) {
+    timestamp_ = unix_ts_ms & MAX_TIMESTAMP;
+    counter_lo_ = pool_.next_u24();
+    ts_counter_hi_ = NEVER_RENEWED;
+  }
+
+  /** Returns the `timestamp` of the last generated ID. */
+  uint64_t timestamp() const { return timestamp_; }
+
+  /** Returns the clock used by this generator. */
+  Clock &clock() { return clock_; }
+
+  /** Returns the policy of this generator. */
+  const GeneratorPolicy &policy() const { return policy_; }
+
+  /** Returns a snapshot of the counters of this generator. */
+  GeneratorStats stats() const { return stats_.snapshot(); }
+
+ private:
+  /**
+   * Updates the state for a new ID to be generated at `unix_ts_ms`.
+   *
+   * `unix_ts_ms` is truncated to 48 bits; the resulting wraparound in year
+   * 10889 is treated as a large clock rollback.
+   */
+  int advance(uint64_t unix_ts_ms) {
+    unix_ts_ms &= MAX_TIMESTAMP;
+    if (unix_ts_ms > timestamp_) {
+      timestamp_ = unix_ts_ms;
+      counter_lo_ = pool_.next_u24();
+    } else if (unix_ts_ms + policy_.rollback_allowance >= timestamp_) {
+      // go on with previous timestamp if new one is not much smaller
+      if (unix_ts_ms < timestamp_) {
+        SCRU128_PROBE2(clock_rollback, timestamp_, unix_ts_ms);
+        GeneratorStats::increment(stats_.tolerated_rollbacks);
+      }
+      increment_counters();
+    } else if (policy_.on_large_rollback == RollbackAction::RESET) {
+      // reset state if clock moves back by more than allowance
+      SCRU128_PROBE2(clock_reset, timestamp_, unix_ts_ms);
+      GeneratorStats::increment(stats_.resets);
+      timestamp_ = unix_ts_ms;
+      ts_counter_hi_ = NEVER_RENEWED;
+      counter_lo_ = pool_.next_u24();
+    } else {
+      SCRU128_PROBE2(clock_abort, timestamp_, unix_ts_ms);
+      GeneratorStats::increment(stats_.aborts);
+      return -1;
+    }
+    renew_counter_hi_if_due();
+    stats_.record_lead(timestamp_, unix_ts_ms);
+    return 0;
+  }
+
+  /**
+   * Reads the clock once and calls `emit(i)` for `n` consecutive IDs, with
+   * the state updated for the `i`-th ID. `counter_lo` is incremented in a
+   * tight loop within each run of IDs that share `timestamp` and `counter_hi`.
+   * Returns non-zero without calling `emit` if `advance()` fails.
+   */
+  template <class Emit> int reserve_run(size_t n, Emit &&emit) {
+    uint64_t unix_ts_ms = clock_.now_ms() & MAX_TIMESTAMP;
+    if (advance(unix_ts_ms) != 0) {
+      return -1;
+    }
+    for (size_t i = 0;;) {
+      size_t run = MAX_COUNTER_LO - counter_lo_ + 1;
+      if (run > n - i) {
+        run = n - i;
+      }
+      for (size_t end = i + run; i < end; i++) {
+        emit(i);
+        counter_lo_++;
+      }
+      counter_lo_--;
+
+      if (i == n) {
+        return 0;
+      }
+      increment_counters();
+      stats_.record_lead(timestamp_, unix_ts_ms);
+    }
+  }
+
+  /** Increments the counters for a new ID within the same `timestamp`. */
+  void increment_counters() {
+    counter_lo_++;
+    if (counter_lo_ > MAX_COUNTER_LO) {
+      counter_lo_ = 0;
+      counter_hi_++;
+      if (counter_hi_ > MAX_COUNTER_HI) {
+        counter_hi_ = 0;
+        // increment timestamp at counter overflow
+        GeneratorStats::increment(stats_.counter_overflows);
+        timestamp_++;
+        SCRU128_PROBE1(counter_overflow, timestamp_);
+        counter_lo_ = pool_.next_u24();
+      }
+    }
+    renew_counter_hi_if_due();
+  }
+
+  /**
+   * Value of `ts_counter_hi_` that forces a renewal of `counter_hi`, which no
+   * 48-bit `timestamp` can take, unlike zero.
+   */
+  static constexpr uint64_t NEVER_RENEWED = UINT64_MAX;
+
+  void renew_counter_hi_if_due() {
+    if (ts_counter_hi_ == NEVER_RENEWED ||
+        timestamp_ - ts_counter_hi_ >= 1000) {
+      // renew counter_hi every second
+      ts_counter_hi_ = timestamp_;
+      counter_hi_ = pool_.next_u24();
+    }
+  }
+
+  Clock clock_;
+  EntropyPool<Random> pool_;
+  GeneratorPolicy policy_;
+  GeneratorStats stats_;
+  uint64_t timestamp_ = 0;
+  uint32_t counter_hi_ = 0;
+  uint32_t counter_lo_ = 0;
+  uint64_t ts_counter_hi_ = NEVER_RENEWED; // timestamp at last renewal
+};
+
+/**
+ * NON-CRYPTOGRAPHIC generator that produces a reproducible stream of IDs from
+ * a seed and a virtual clock, for load tests and benchmarks only.
+ *
+ * The IDs follow the same counter rules as production IDs and are therefore
+ * indistinguishable in shape, but their random fields come from `WyrandRandom`
+ * and are predictable. For example, the following generator emits the same
+ * IDs on every run, starting at `start_ms` and advancing the clock by one
+ * millisecond every 1000 calls to `generate()`:
+ *
+ *     DeterministicGenerator g(VirtualClock(start_ms, 1000), WyrandRandom(42));
+ *
+ * `generate_many()` reads the clock only once per batch and is the fastest way
+ * to produce bulk output.
+ */
+using DeterministicGenerator = Generator<VirtualClock, WyrandRandom>;
+
+/**
+ * Generates SCRU128 IDs without keeping state between calls.
+ *
+ * This is the stateless variant described in the specification: each ID
+ * consists of the current `timestamp` and 80 random bits that fill
+ * `counter_hi`, `counter_lo`, and `entropy`, drawn from the buffered entropy
+ * pool. IDs are ordered by `timestamp` only and are not monotonic within a
+ * millisecond, and the collision resistance of the three-layer randomness is
+ * lost; in exchange, the generator has no state to share or synchronize, so
+ * threads that generate IDs infrequently can each own an instance without
+ * any contention. Prefer `Generator` otherwise.
+ *
+ * An instance is not thread-safe; use one instance per thread.
+ */
+template <class Clock = RealtimeClock, class Random = SystemRandom>
+class StatelessGenerator {
+ public:
+  explicit StatelessGenerator(Clock clock = Clock(), Random random = Random())
+      : clock_(clock), pool_(random) {}
+
+  /**
+   * Generates a new ID.
+   *
+   * @param out 16-byte byte array
+   * @return zero (never fails)
+   */
+  int generate(uint8_t *out) {
+    uint64_t timestamp = clock_.now_ms() & MAX_TIMESTAMP;
+    out[0] = timestamp >> 40;
+    out[1] = timestamp >> 32;
+    out[2] = timestamp >> 24;
+    out[3] = timestamp >> 16;
+    out[4] = timestamp >> 8;
+    out[5] = timestamp;
+    pool_.fill(out + 6, 10);
+    return 0;
+  }
+
+  /** Returns the clock used by this generator. */
+  Clock &clock() { return clock_; }
+
+ private:
+  Clock clock_;
+  EntropyPool<Random> pool_;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_GENERATOR_HPP */
@@ -0,0 +1,496 @@
+/** generator_test.cpp - Tests for generator.hpp and clock.hpp */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock.hpp"
+#include "codec.hpp"
+#include "generator.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+static uint64_t timestamp_of(const uint8_t *id) {
+  uint64_t ts = 0;
+  for (int i = 0; i < 6; i++) {
+    ts = ts << 8 | id[i];
+  }
+  return ts;
+}
+
+static uint32_t counter_hi_of(const uint8_t *id) {
+  return (uint32_t)id[6] << 16 | (uint32_t)id[7] << 8 | id[8];
+}
+
+static uint32_t counter_lo_of(const uint8_t *id) {
+  return (uint32_t)id[9] << 16 | (uint32_t)id[10] << 8 | id[11];
+}
+
+/** Generates IDs in monotonic order with up-to-date timestamps. */
+static void test_monotonic_order(void) {
+  Generator<> g;
+  uint8_t prev[16], curr[16];
+  uint64_t before = read_posix_clock_ms(CLOCK_REALTIME);
+  g.generate(prev);
+  for (int i = 0; i < 100000; i++) {
+    g.generate(curr);
+    assert(memcmp(prev, curr, 16) < 0);
+    memcpy(prev, curr, 16);
+  }
+  uint64_t after = read_posix_clock_ms(CLOCK_REALTIME);
+  assert(timestamp_of(curr) >= before && timestamp_of(curr) <= after);
+}
+
+/** Increments `timestamp` and resets counters on counter overflow. */
+static void test_counter_overflow(void) {
+  Generator<FixedClock, MaxRandom> g;
+  g.clock().now = T;
+
+  uint8_t id[16];
+  g.generate(id);
+  assert(timestamp_of(id) == T);
+  assert(counter_hi_of(id) == MAX_COUNTER_HI);
+  assert(counter_lo_of(id) == MAX_COUNTER_LO);
+
+  g.generate(id);
+  assert(timestamp_of(id) == 0x017fee7fef42);
+  assert(counter_hi_of(id) == 0);
+  assert(counter_lo_of(id) == MAX_COUNTER_LO);
+  assert(g.stats().counter_overflows == 1);
+  assert(g.stats().timestamp_lead_ms == 1);
+  assert(g.stats().max_timestamp_lead_ms == 1);
+}
+
+/** Absorbs small clock rollbacks and resets on large ones. */
+static void test_clock_rollback(void) {
+  Generator<FixedClock> g;
+  uint64_t ts = T;
+  uint8_t prev[16], curr[16];
+
+  g.clock().now = ts;
+  g.generate(prev);
+  g.clock().now = ts - DEFAULT_ROLLBACK_ALLOWANCE;
+  g.generate(curr);
+  assert(timestamp_of(curr) == ts);
+  assert(memcmp(prev, curr, 16) < 0);
+
+  g.clock().now = ts - DEFAULT_ROLLBACK_ALLOWANCE - 1;
+  g.generate(curr);
+  assert(timestamp_of(curr) == ts - DEFAULT_ROLLBACK_ALLOWANCE - 1);
+
+  assert(g.stats().tolerated_rollbacks == 1);
+  assert(g.stats().resets == 1);
+  assert(g.stats().timestamp_lead_ms == 0);
+  assert(g.stats().max_timestamp_lead_ms ==
+         (int64_t)DEFAULT_ROLLBACK_ALLOWANCE);
+}
+
+/** Applies configured rollback allowance and action. */
+static void test_rollback_policy(void) {
+  GeneratorPolicy policy;
+  policy.rollback_allowance = 100;
+  policy.on_large_rollback = RollbackAction::ABORT;
+  Generator<FixedClock> g(FixedClock(), SystemRandom(), policy);
+  uint64_t ts = T;
+  uint8_t prev[16], curr[16];
+
+  g.clock().now = ts;
+  assert(g.generate(prev) == 0);
+  g.clock().now = ts - 100;
+  assert(g.generate(curr) == 0);
+  assert(timestamp_of(curr) == ts);
+  assert(memcmp(prev, curr, 16) < 0);
+  assert(g.stats().timestamp_lead_ms == 100);
+
+  memcpy(prev, curr, 16);
+  g.clock().now = ts - 101;
+  uint8_t ids[3 * 16];
+  char buf[26];
+  assert(g.generate(curr) != 0);
+  assert(g.generate_many(3, ids) != 0);
+  assert(g.generate_text(1, buf, sizeof(buf)) == 0);
+  assert(g.stats().aborts == 3);
+  assert(g.stats().resets == 0);
+
+  // generation resumes in order once clock catches up
+  g.clock().now = ts - 50;
+  assert(g.generate(curr) == 0);
+  assert(memcmp(prev, curr, 16) < 0);
+  assert(g.stats().tolerated_rollbacks == 2);
+}
+
+/** Renews `counter_hi` once a second. */
+static void test_counter_hi_renewal(void) {
+  Generator<FixedClock> g;
+  uint64_t ts = T;
+  uint8_t id[16];
+
+  g.clock().now = ts;
+  g.generate(id);
+  uint32_t counter_hi = counter_hi_of(id);
+  for (uint64_t i = 1; i < 1000; i++) {
+    g.clock().now = ts + i;
+    g.generate(id);
+    assert(counter_hi_of(id) == counter_hi);
+  }
+  int renewed = 0;
+  for (int i = 0; i < 8; i++) {
+    g.clock().now += 1000;
+    g.generate(id);
+    renewed += counter_hi_of(id) != counter_hi;
+  }
+  assert(renewed > 0);
+
+  // keeps counter_hi at timestamp zero, the default start of VirtualClock
+  DeterministicGenerator g0(VirtualClock(0, 500), WyrandRandom(1));
+  uint8_t prev[16];
+  g0.generate(prev);
+  for (int i = 0; i < 2000; i++) {
+    g0.generate(id);
+    assert(memcmp(prev, id, 16) < 0);
+    assert(timestamp_of(id) > 0 || counter_hi_of(id) == counter_hi_of(prev));
+    memcpy(prev, id, 16);
+  }
+}
+
+/** Generates a batch equivalent to consecutive calls to `generate()`. */
+static void test_generate_many(void) {
+  const size_t N = 100000;
+  static uint8_t ids[N * 16];
+  static char texts[N * 26];
+
+  Generator<> g;
+  uint8_t prev[16];
+  g.generate(prev);
+  g.generate_many(N, ids, texts);
+  for (size_t i = 0; i < N; i++) {
+    const uint8_t *curr = ids + 16 * i;
+    assert(memcmp(prev, curr, 16) < 0);
+    if (timestamp_of(prev) == timestamp_of(curr) &&
+        counter_hi_of(prev) == counter_hi_of(curr)) {
+      assert(counter_lo_of(prev) + 1 == counter_lo_of(curr));
+    }
+    memcpy(prev, curr, 16);
+
+    char expected[26];
+    encode(curr, expected);
+    assert(memcmp(expected, texts + 26 * i, 26) == 0);
+  }
+  g.generate(ids);
+  assert(memcmp(prev, ids, 16) < 0);
+
+  // entropy is drawn for every ID rather than copied
+  int distinct = 0;
+  for (size_t i = 1; i < N; i++) {
+    distinct += memcmp(ids + 16 * i + 12, ids + 16 * (i - 1) + 12, 4) != 0;
+  }
+  assert(distinct > (int)N / 2);
+}
+
+/** Carries `counter_lo` into `counter_hi` and overflows within a batch. */
+static void test_generate_many_overflow(void) {
+  Generator<FixedClock, MaxRandom> g;
+  g.clock().now = T;
+
+  uint8_t ids[3 * 16];
+  g.generate_many(3, ids);
+  assert(timestamp_of(ids) == T);
+  assert(counter_hi_of(ids) == MAX_COUNTER_HI);
+  assert(counter_lo_of(ids) == MAX_COUNTER_LO);
+  assert(timestamp_of(ids + 16) == 0x017fee7fef42);
+  assert(counter_hi_of(ids + 16) == 0);
+  assert(counter_lo_of(ids + 16) == MAX_COUNTER_LO);
+  assert(timestamp_of(ids + 32) == 0x017fee7fef42);
+  assert(counter_hi_of(ids + 32) == 1);
+  assert(counter_lo_of(ids + 32) == 0);
+  assert(g.stats().counter_overflows == 1);
+  assert(g.stats().timestamp_lead_ms == 1);
+  assert(g.stats().max_timestamp_lead_ms == 1);
+
+  // a copy carries the state and the counters on independently
+  Generator<FixedClock, MaxRandom> copy = g;
+  copy.generate(ids);
+  assert(copy.stats().counter_overflows == 1);
+  g.generate(ids);
+  assert(timestamp_of(ids) == 0x017fee7fef42);
+  assert(counter_hi_of(ids) == 1);
+  assert(counter_lo_of(ids) == 1);
+}
+
+/** Writes delimited records that decode to monotonically ordered IDs. */
+static void test_generate_text(void) {
+  char buf[26 * 100 + 10];
+  Generator<> g;
+
+  size_t len = g.generate_text(1000, buf, sizeof(buf), '\n');
+  assert(len == 26 * 100);
+  for (size_t i = 0; i < 100; i++) {
+    const char *record = buf + 26 * i;
+    assert(record[25] == '\n');
+    for (int j = 0; j < 25; j++) {
+      assert((record[j] >= '0' && record[j] <= '9') ||
+             (record[j] >= 'a' && record[j] <= 'z'));
+    }
+    if (i > 0) {
+      assert(memcmp(record - 26, record, 25) < 0);
+    }
+  }
+
+  len = g.generate_text(3, buf, sizeof(buf), ',');
+  assert(len == 26 * 3);
+  assert(buf[25] == ',' && buf[51] == ',' && buf[77] == ',');
+  assert(g.generate_text(1, buf, 25) == 0);
+}
+
+/** Fills all 80 bits after `timestamp` with fresh random bits. */
+static void test_stateless_generator(void) {
+  StatelessGenerator<FixedClock> g;
+  g.clock().now = T;
+
+  const int N = 10000;
+  static uint8_t ids[N * 16];
+  int ones[80] = {0};
+  for (int i = 0; i < N; i++) {
+    uint8_t *id = ids + 16 * i;
+    assert(g.generate(id) == 0);
+    assert(timestamp_of(id) == T);
+    for (int j = 0; j < 80; j++) {
+      ones[j] += id[6 + j / 8] >> (7 - j % 8) & 1;
+    }
+    if (i > 0) {
+      assert(memcmp(id + 6, id - 10, 10) != 0);
+    }
+  }
+  // each bit is set in about half of IDs (mean 5000, sd 50)
+  for (int j = 0; j < 80; j++) {
+    assert(ones[j] > 4700 && ones[j] < 5300);
+  }
+}
+
+/** Reproduces the same stream of IDs from the same seed. */
+static void test_deterministic_generator(void) {
+  const size_t N = 200000;
+  static uint8_t a[N * 16], b[N * 16];
+  uint64_t start = T;
+
+  // 100 IDs per millisecond for 2 seconds
+  DeterministicGenerator g1(VirtualClock(start, 100), WyrandRandom(42));
+  DeterministicGenerator g2(VirtualClock(start, 100), WyrandRandom(42));
+  DeterministicGenerator g3(VirtualClock(start, 100), WyrandRandom(43));
+  for (size_t i = 0; i < N; i++) {
+    assert(g1.generate(a + 16 * i) == 0);
+    assert(g2.generate(b + 16 * i) == 0);
+  }
+  assert(memcmp(a, b, sizeof(a)) == 0);
+  g3.generate(b);
+  assert(memcmp(a, b, 16) != 0);
+
+  // IDs follow the counter rules of production generators
+  assert(timestamp_of(a) == start);
+  assert(timestamp_of(a + 16 * (N - 1)) == start + (N - 1) / 100);
+  for (size_t i = 1; i < N; i++) {
+    const uint8_t *prev = a + 16 * (i - 1), *curr = a + 16 * i;
+    assert(memcmp(prev, curr, 16) < 0);
+    if (timestamp_of(prev) == timestamp_of(curr)) {
+      assert(counter_lo_of(prev) + 1 == counter_lo_of(curr) ||
+             counter_lo_of(curr) == 0);
+    }
+    bool renewal_due = timestamp_of(prev) != timestamp_of(curr) &&
+                       (timestamp_of(curr) - start) % 1000 == 0;
+    if (!renewal_due && counter_lo_of(curr) != 0) {
+      assert(counter_hi_of(prev) == counter_hi_of(curr));
+    }
+  }
+
+  DeterministicGenerator g4(VirtualClock(start), WyrandRandom(42));
+  DeterministicGenerator g5(VirtualClock(start), WyrandRandom(42));
+  g4.generate_many(N, a);
+  g5.generate_many(N, b);
+  assert(memcmp(a, b, sizeof(a)) == 0);
+}
+
+/** Drives generators with a virtual clock through a shared reference. */
+static void test_virtual_clock(void) {
+  uint64_t ts = T;
+  VirtualClock clock(ts);
+  Generator<ClockRef<VirtualClock>> a{ClockRef<VirtualClock>(&clock)};
+  Generator<ClockRef<VirtualClock>> b{ClockRef<VirtualClock>(&clock)};
+  uint8_t prev[16], curr[16];
+
+  // frozen clock
+  a.generate(prev);
+  for (int i = 0; i < 100000; i++) {
+    a.generate(curr);
+    assert(timestamp_of(curr) == ts);
+    assert(memcmp(prev, curr, 16) < 0);
+    memcpy(prev, curr, 16);
+  }
+
+  // backward jump seen by both generators
+  clock.rewind(3);
+  a.generate(curr);
+  assert(timestamp_of(curr) == ts);
+  assert(a.stats().tolerated_rollbacks == 1);
+  assert(a.stats().timestamp_lead_ms == 3);
+  b.generate(curr);
+  assert(timestamp_of(curr) == ts - 3);
+  assert(b.stats().tolerated_rollbacks == 0);
+
+  // automatic advancement
+  clock.set(ts + 10);
+  clock.set_reads_per_ms(2);
+  assert(clock.now_ms() == ts + 10);
+  assert(clock.now_ms() == ts + 10);
+  assert(clock.now_ms() == ts + 11);
+  clock.set_reads_per_ms(0);
+  assert(clock.now_ms() == ts + 11);
+  assert(clock.now_ms() == ts + 11);
+}
+
+/** Reads each clock source close to the wall clock. */
+static void test_clock_sources(void) {
+  RealtimeClock realtime;
+  CoarseRealtimeClock coarse;
+  TscClock tsc(/* calibration_interval_ms */ 50);
+
+  uint64_t coarse_res = CoarseRealtimeClock::resolution_ms();
+  for (int i = 0; i < 200; i++) {
+    uint64_t expected = realtime.now_ms();
+    uint64_t c = coarse.now_ms();
+    uint64_t t = tsc.now_ms();
+    assert(c + coarse_res * 4 >= expected && c <= expected + 1);
+    assert(t + 2 >= expected && t <= expected + 2);
+    struct timespec delay = {0, 1000000};
+    nanosleep(&delay, NULL);
+  }
+  assert(tsc.last_drift_ns() < 1000000 && tsc.last_drift_ns() > -1000000);
+
+  // a zero warmup still measures the tick rate over a positive interval
+  TscClock quick(1000, 0);
+  assert(quick.ticks_per_second() > 1e6 && quick.ticks_per_second() < 1e11);
+  uint64_t expected = realtime.now_ms();
+  uint64_t t = quick.now_ms();
+  assert(t + 2 >= expected && t <= expected + 2);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+template <class Clock> static void bench_clock(const char *name, Clock clock) {
+  const int N = 10000000;
+  uint64_t sink = 0;
+  uint64_t start = now_ns();
+  for (int i = 0; i < N; i++) {
+    sink += clock.now_ms();
+  }
+  double clock_ns = (double)(now_ns() - start) / N;
+
+  Generator<Clock> g(clock);
+  uint8_t id[16] = {};
+  start = now_ns();
+  for (int i = 0; i < N; i++) {
+    g.generate(id);
+    sink += id[15];
+  }
+  double gen_ns = (double)(now_ns() - start) / N;
+
+  printf("%-20s now_ms: %6.2f ns/call  generate: %6.2f ns/id  (%llu)\n", name,
+         clock_ns, gen_ns, (unsigned long long)(sink & 1));
+}
+
+static void bench_generate_many(void) {
+  const size_t N = 1000000;
+  static uint8_t ids[N * 16];
+  static char texts[N * 26];
+  Generator<> g;
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    g.generate(ids + 16 * i);
+  }
+  double single_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  g.generate_many(N, ids);
+  double many_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  g.generate_many(N, ids, texts);
+  double many_text_ns = (double)(now_ns() - start) / N;
+
+  static char lines[N * 26];
+  start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    g.generate(ids + 16 * i);
+    encode(ids + 16 * i, texts + 26 * i);
+    texts[26 * i + 25] = '\n';
+  }
+  double two_pass_ns = (double)(now_ns() - start) / N;
+
+  // fill page-sized buffers as a log shipper would before write()
+  const size_t CHUNK = 4096 / 26 * 26;
+  start = now_ns();
+  for (size_t off = 0; off < sizeof(lines);) {
+    size_t len = sizeof(lines) - off < CHUNK ? sizeof(lines) - off : CHUNK;
+    off += g.generate_text(N, lines + off, len);
+  }
+  double fused_ns = (double)(now_ns() - start) / N;
+
+  printf("generate: %6.2f ns/id  generate_many: %6.2f ns/id  "
+         "generate_many with text: %6.2f ns/id\n",
+         single_ns, many_ns, many_text_ns);
+  printf("generate + encode lines: %6.2f ns/id  generate_text: %6.2f ns/id\n",
+         two_pass_ns, fused_ns);
+}
+
+/** Measures bulk output rate of the deterministic generator. */
+static void bench_deterministic(void) {
+  const size_t N = 1 << 20;
+  static uint8_t ids[N * 16];
+  DeterministicGenerator g(VirtualClock(T), WyrandRandom(42));
+
+  const int ROUNDS = 64;
+  uint64_t start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    g.clock().advance(1);
+    g.generate_many(N, ids);
+  }
+  double elapsed = (double)(now_ns() - start);
+  printf("DeterministicGenerator generate_many: %6.2f ns/id  %6.2f GB/s\n",
+         elapsed / N / ROUNDS, (double)sizeof(ids) * ROUNDS / elapsed);
+}
+
+static void run_benchmarks(void) {
+  bench_clock("RealtimeClock", RealtimeClock());
+  bench_clock("CoarseRealtimeClock", CoarseRealtimeClock());
+  bench_clock("TscClock", TscClock());
+  bench_generate_many();
+  bench_deterministic();
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_monotonic_order();
+  test_counter_overflow();
+  test_clock_rollback();
+  test_rollback_policy();
+  test_counter_hi_renewal();
+  test_generate_many();
+  test_generate_many_overflow();
+  test_generate_text();
+  test_stateless_generator();
+  test_deterministic_generator();
+  test_virtual_clock();
+  test_clock_sources();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
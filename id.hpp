@@ -0,0 +1,168 @@
+/** id.hpp - SCRU128 ID value type held in native 64-bit words */
+
+#ifndef SCRU128_ID_HPP
+#define SCRU128_ID_HPP
+
+#include <compare>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "codec.hpp"
+
+namespace scru128 {
+
+/** Maximum value of 48-bit `timestamp` field. */
+constexpr uint64_t MAX_TIMESTAMP = 0xffffffffffff;
+
+/**
+ * 128-bit SCRU128 ID stored as two native 64-bit words.
+ *
+ * Unlike the 16-byte big-endian byte array accepted by `encode()` and
+ * `decode()`, this representation needs no byte swaps to be compared, to have
+ * its fields extracted, or to be converted to and from `unsigned __int128`,
+ * and the text conversions run on the words directly through
+ * `encode_words()` and `decode_words()`. The type is trivially copyable and
+ * aligned to 16 bytes, so that arrays of IDs can be loaded with aligned vector
+ * instructions; the order of the two words in memory is fixed (`hi` first)
+ * regardless of the byte order of the platform, while the bytes within each
+ * word are in native order. Use `to_bytes()` to get the portable binary form.
+ *
+ * IDs compare in the numeric order of their 128-bit values, which is the
+ * same as the lexicographic order of their textual and binary forms.
+ */
+struct alignas(16) Id {
+  /** Upper 64 bits: `timestamp` and upper 16 bits of `counter_hi`. */
+  uint64_t hi;
+
+  /** Lower 64 bits: the rest of `counter_hi`, `counter_lo`, and `entropy`. */
+  uint64_t lo;
+
+  /** Returns an ID from the four fields, each truncated to its width. */
+  static constexpr Id from_fields(uint64_t timestamp, uint32_t counter_hi,
+                                  uint32_t counter_lo, uint32_t entropy) {
+    return Id{(timestamp & MAX_TIMESTAMP) << 16 | (counter_hi & 0xffffff) >> 8,
+              (uint64_t)(counter_hi & 0xff) << 56 |
+                  (uint64_t)(counter_lo & 0xffffff) << 32 | entropy};
+  }
+
+  /** Returns an ID from a 128-bit unsigned integer. */
+  static constexpr Id from_u128(unsigned __int128 value) {
+    return Id{(uint64_t)(value >> 64), (uint64_t)value};
+  }
+
+  /** Returns an ID from a 16-byte big-endian byte array. */
+  static constexpr Id from_bytes(const uint8_t *bytes) {
+    Id id = {0, 0};
+    for (int i = 0; i < 8; i++) {
+      id.hi = id.hi << 8 | bytes[i];
+      id.lo = id.lo << 8 | bytes[i + 8];
+    }
+    return id;
+  }
+
+  /**
+   * Decodes an ID from a 25-digit Base36 string.
+   *
+   * @param text 26-byte string (25 digits and terminating NUL)
+   * @param out receives the ID
+   * @return zero on success or non-zero on failure
+   */
+  static constexpr int decode(const char *text, Id *out) {
+    uint64_t hi, lo;
+    if (decode_string(text, &hi, &lo) != 0) {
+      return -1;
+    }
+    *out = Id{hi, lo};
+    return 0;
+  }
+
+  /** Returns the 128-bit unsigned integer value. */
+  constexpr unsigned __int128 to_u128() const {
+    return (unsigned __int128)hi << 64 | lo;
+  }
+
+  /** Writes the 16-byte big-endian byte array. */
+  constexpr void to_bytes(uint8_t *out) const {
+    for (int i = 0; i < 8; i++) {
+      out[i] = (uint8_t)(hi >> (56 - 8 * i));
+      out[i + 8] = (uint8_t)(lo >> (56 - 8 * i));
+    }
+  }
+
+  /**
+   * Encodes the ID in a 25-digit Base36 string.
+   *
+   * @param out 26-byte string (25 digits and terminating NUL)
+   */
+  constexpr void encode(char *out) const {
+    encode_words(hi, lo, out);
+    out[25] = '\0';
+  }
+
+  /** Returns the 48-bit `timestamp` field. */
+  constexpr uint64_t timestamp() const { return hi >> 16; }
+
+  /** Returns the 24-bit `counter_hi` field. */
+  constexpr uint32_t counter_hi() const {
+    return (uint32_t)(hi & 0xffff) << 8 | (uint32_t)(lo >> 56);
+  }
+
+  /** Returns the 24-bit `counter_lo` field. */
+  constexpr uint32_t counter_lo() const {
+    return (uint32_t)(lo >> 32) & 0xffffff;
+  }
+
+  /** Returns the 32-bit `entropy` field. */
+  constexpr uint32_t entropy() const { return (uint32_t)lo; }
+
+  /**
+   * Returns true if `timestamp` is zero or `2^48 - 1`, i.e., if the ID is
+   * reserved for special purposes and must not be used as an identifier.
+   */
+  constexpr bool is_reserved() const {
+    return timestamp() == 0 || timestamp() == MAX_TIMESTAMP;
+  }
+
+  friend constexpr bool operator==(const Id &, const Id &) = default;
+  friend constexpr std::strong_ordering operator<=>(const Id &,
+                                                    const Id &) = default;
+};
+
+static_assert(sizeof(Id) == 16 && alignof(Id) == 16);
+
+/**
+ * Called by `operator""_scru128` on an invalid literal; being neither
+ * `constexpr` nor defined, it turns the literal into a compile error that
+ * names this function.
+ */
+void invalid_scru128_literal();
+
+inline namespace literals {
+
+/**
+ * Converts a 25-digit Base36 string literal into an `Id` at compile time:
+ *
+ *     using namespace scru128::literals;
+ *     constexpr Id id = "0372hg16csmsm50l8dikcvukc"_scru128;
+ *
+ * A literal that is not a valid ID fails to compile.
+ */
+consteval Id operator""_scru128(const char *text, size_t len) {
+  uint64_t hi = 0, lo = 0;
+  if (len != 25 || decode_words(text, &hi, &lo) != 0) {
+    invalid_scru128_literal();
+  }
+  return Id{hi, lo};
+}
+
+} // namespace literals
+
+/** Minimum ID, reserved for special purposes. */
+constexpr Id MIN_ID = "0000000000000000000000000"_scru128;
+
+/** Maximum ID, reserved for special purposes. */
+constexpr Id MAX_ID = "f5lxx1zz5pnorynqglhzmsp33"_scru128;
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_ID_HPP */
@@ -0,0 +1,211 @@
+/** id_file.hpp - Read-only index over memory-mapped files of sorted IDs */
+
+#ifndef SCRU128_ID_FILE_HPP
+#define SCRU128_ID_FILE_HPP
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "id.hpp"
+#include "time_range.hpp"
+
+namespace scru128 {
+
+/**
+ * Searches `[begin, end)` of `ids`, an array of sorted 16-byte binary IDs, for
+ * the first ID not less than `key` by interpolation on `timestamp`.
+ *
+ * Archived IDs are spread roughly uniformly over time, so the position of a
+ * `timestamp` between two known IDs is predicted well by linear interpolation,
+ * though only to within the IDs of a millisecond. Each interpolated probe is
+ * therefore followed by a gallop toward the key, `GUARD` IDs (within a page or
+ * the next) and then twice as far each time, which brackets the key from both
+ * sides in a few probes close to each other, instead of closing in on it from
+ * one side. On 10 million IDs, a lookup touches about 5 pages against about 16
+ * for a binary search. A step that fails to halve the range (on bursts, gaps,
+ * or a range within one millisecond) is followed by a bisection, so that the
+ * search never takes many more probes than a binary search, and short ranges
+ * are finished by binary search.
+ *
+ * @param ids sorted array of 16-byte binary IDs
+ * @param begin first index of the range to search
+ * @param end index past the range to search
+ * @param key ID to search for
+ * @return index of the first ID not less than `key`, or `end` if none
+ */
+inline size_t interpolation_search(const uint8_t *ids, size_t begin,
+                                   size_t end, const Id &key) {
+  const size_t GUARD = 64, SMALL_RANGE = 16;
+  auto id_at = [ids](size_t i) { return Id::from_bytes(ids + 16 * i); };
+  if (begin == end || !(id_at(begin) < key)) {
+    return begin;
+  } else if (id_at(end - 1) < key) {
+    return end;
+  }
+
+  // the result is in `(left, right]`, where `ids[left] < key <= ids[right]`
+  size_t left = begin, right = end - 1;
+  uint64_t t_left = id_at(left).timestamp();
+  uint64_t t_right = id_at(right).timestamp();
+  uint64_t t = key.timestamp();
+  bool bisect = false;
+  while (right - left > SMALL_RANGE) {
+    size_t width = right - left, probe;
+    if (bisect || t_left == t_right) {
+      probe = left + width / 2;
+    } else {
+      // `t_left <= t <= t_right` holds as the IDs at the fences bracket `key`
+      probe = left + (size_t)((unsigned __int128)(t - t_left) * width /
+                              (t_right - t_left));
+      probe = probe > left ? probe : left + 1;
+      probe = probe < right ? probe : right - 1;
+    }
+    // gallop from the probe toward the key to bracket it from both sides
+    Id id = id_at(probe);
+    if (id < key) {
+      left = probe;
+      t_left = id.timestamp();
+      for (size_t step = GUARD; !bisect && right - left > step; step *= 2) {
+        Id next = id_at(left + step);
+        if (!(next < key)) {
+          right = left + step;
+          t_right = next.timestamp();
+          break;
+        }
+        left += step;
+        t_left = next.timestamp();
+      }
+    } else {
+      right = probe;
+      t_right = id.timestamp();
+      for (size_t step = GUARD; !bisect && right - left > step; step *= 2) {
+        Id next = id_at(right - step);
+        if (next < key) {
+          left = right - step;
+          t_left = next.timestamp();
+          break;
+        }
+        right -= step;
+        t_right = next.timestamp();
+      }
+    }
+    bisect = !bisect && right - left > width / 2;
+  }
+
+  for (size_t count = right - left; count > 0;) {
+    size_t half = count / 2;
+    if (id_at(left + 1 + half) < key) {
+      left += half + 1;
+      count -= half + 1;
+    } else {
+      count = half;
+    }
+  }
+  return left + 1;
+}
+
+/**
+ * Read-only index over a memory-mapped file of sorted 16-byte binary IDs,
+ * such as an archive written by `FdSink` (see `merge.hpp`).
+ *
+ * The file is mapped with `MADV_RANDOM`, as lookups touch a few scattered
+ * pages and read-ahead would only fetch pages that are not used. The IDs are
+ * not verified to be sorted; lookups in an unsorted file return unspecified
+ * positions.
+ */
+class IdFile {
+ public:
+  IdFile() = default;
+  IdFile(const IdFile &) = delete;
+  IdFile &operator=(const IdFile &) = delete;
+  ~IdFile() { close(); }
+
+  /**
+   * Maps a file of IDs.
+   *
+   * @param path path to a file whose size is a multiple of 16 bytes
+   * @return zero on success or non-zero on failure
+   */
+  int open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size % 16 != 0) {
+      ::close(fd);
+      return -1;
+    }
+    if (st.st_size == 0) {
+      ::close(fd);
+      return 0; // mmap() rejects an empty mapping
+    }
+    void *addr =
+        mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      return -1;
+    }
+    madvise(addr, (size_t)st.st_size, MADV_RANDOM);
+    data_ = (const uint8_t *)addr;
+    size_ = (size_t)st.st_size / 16;
+    return 0;
+  }
+
+  /** Unmaps the file. */
+  void close() {
+    if (data_ != nullptr) {
+      munmap((void *)data_, 16 * size_);
+      data_ = nullptr;
+    }
+    size_ = 0;
+  }
+
+  /** Returns the number of IDs. */
+  size_t size() const { return size_; }
+
+  /** Returns the mapped IDs as a `size()` * 16-byte byte array. */
+  const uint8_t *data() const { return data_; }
+
+  /** Returns the ID at an index. */
+  Id operator[](size_t index) const {
+    return Id::from_bytes(data_ + 16 * index);
+  }
+
+  /** Returns the index of the first ID not less than `id`, or `size()`. */
+  size_t lower_bound(const Id &id) const {
+    return interpolation_search(data_, 0, size_, id);
+  }
+
+  /** Returns the index of an ID, or `size()` if the file does not have it. */
+  size_t find(const Id &id) const {
+    size_t index = lower_bound(id);
+    return index < size_ && (*this)[index] == id ? index : size_;
+  }
+
+  /**
+   * Finds the IDs whose `timestamp` is in `[t0, t1)`.
+   *
+   * @param begin receives the index of the first ID in the range
+   * @param end receives the index past the last ID in the range
+   */
+  void time_range(uint64_t t0, uint64_t t1, size_t *begin,
+                  size_t *end) const {
+    TimeRange range = TimeRange::from_timestamps(t0, t1);
+    *begin = lower_bound(range.lower);
+    *end = interpolation_search(data_, *begin, size_, range.upper);
+  }
+
+ private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_ID_FILE_HPP */
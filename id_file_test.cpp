@@ -0,0 +1,233 @@
+/** id_file_test.cpp - Tests for id_file.hpp */
+
+#include <algorithm>
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "generator.hpp"
+#include "id.hpp"
+#include "id_file.hpp"
+#include "random.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+/** Writes IDs to a new temporary file and stores its path in `path`. */
+static void write_file(const std::vector<Id> &ids, char *path) {
+  strcpy(path, "/tmp/scru128-ids-XXXXXX");
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  std::vector<uint8_t> bytes(16 * ids.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    ids[i].to_bytes(&bytes[16 * i]);
+  }
+  assert(write(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size());
+  close(fd);
+}
+
+/** Looks up keys in a file and checks the results with `std::lower_bound`. */
+static void check_lookups(const std::vector<Id> &ids) {
+  char path[64];
+  write_file(ids, path);
+  IdFile file;
+  assert(file.open(path) == 0);
+  unlink(path);
+  assert(file.size() == ids.size());
+
+  WyrandRandom rng(2);
+  std::vector<Id> keys = {Id{0, 0}, Id{~0ull, ~0ull}};
+  for (size_t k = 0; k < 2000 && !ids.empty(); k++) {
+    const Id &id = ids[rng.next_u64() % ids.size()];
+    keys.push_back(id);
+    keys.push_back(Id::from_u128(id.to_u128() - 1));
+    keys.push_back(Id::from_u128(id.to_u128() + 1));
+    keys.push_back(Id::from_fields(id.timestamp(), 0, 0, 0));
+    keys.push_back(Id::from_fields(id.timestamp() + 1, 0, 0, 0));
+  }
+  for (const Id &key : keys) {
+    size_t expected =
+        (size_t)(std::lower_bound(ids.begin(), ids.end(), key) - ids.begin());
+    assert(file.lower_bound(key) == expected);
+    bool present = expected < ids.size() && ids[expected] == key;
+    assert(file.find(key) == (present ? expected : ids.size()));
+  }
+
+  for (size_t k = 0; k < 200 && !ids.empty(); k++) {
+    uint64_t t0 = ids[rng.next_u64() % ids.size()].timestamp() - 1;
+    uint64_t t1 = t0 + rng.next_u64() % 1000;
+    size_t begin, end;
+    file.time_range(t0, t1, &begin, &end);
+    for (size_t i = 0; i < ids.size(); i++) {
+      bool in = ids[i].timestamp() >= t0 && ids[i].timestamp() < t1;
+      assert(in == (i >= begin && i < end));
+    }
+  }
+}
+
+/** Looks up IDs in uniform, bursty, and degenerate files. */
+static void test_lookups(void) {
+  check_lookups(generate_ids(100000, 10));
+  check_lookups(generate_ids(5000, 100000)); // all in one millisecond
+  check_lookups(generate_ids(17, 1));
+  check_lookups({});
+
+  // a burst of 9000 IDs in one millisecond each hour amid sparse IDs
+  std::vector<Id> bursty = generate_ids(30000, 3);
+  WyrandRandom rng(3);
+  for (size_t i = 0; i < bursty.size(); i++) {
+    uint64_t t = bursty[i].timestamp();
+    if (i % 10000 < 9000) {
+      t = T + 3600000 * (i / 10000);
+    } else {
+      t += 3600000 * (i / 10000) + (rng.next_u64() % 3600000);
+    }
+    bursty[i] = Id::from_fields(t, bursty[i].counter_hi(),
+                                bursty[i].counter_lo(), bursty[i].entropy());
+  }
+  std::sort(bursty.begin(), bursty.end());
+  check_lookups(bursty);
+}
+
+/** Rejects files that are missing or not a sequence of 16-byte IDs. */
+static void test_open(void) {
+  IdFile file;
+  assert(file.open("/nonexistent/scru128-ids") != 0);
+
+  char path[64];
+  std::vector<Id> ids = generate_ids(3, 1);
+  write_file(ids, path);
+  int fd = open(path, O_WRONLY | O_APPEND);
+  assert(fd >= 0 && write(fd, "x", 1) == 1);
+  close(fd);
+  assert(file.open(path) != 0);
+  assert(truncate(path, 48) == 0);
+  assert(file.open(path) == 0);
+  assert(file.size() == 3 && file[2] == ids[2]);
+  unlink(path);
+  file.close();
+  assert(file.size() == 0);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t page_faults(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (uint64_t)(usage.ru_minflt + usage.ru_majflt);
+}
+
+/**
+ * Compares `IdFile::lower_bound()` with binary search on a file of
+ * `ID_FILE_BENCH_MAX` IDs (default 1e8, 1.6 GB), with 1000 and 100000
+ * lookups per mapping, first with the file evicted from the page cache (as far
+ * as the kernel lets it go) and then with the pages cached but freshly mapped,
+ * counting page faults per lookup. Binary search shares the pages of its first
+ * steps among lookups, which pays off only with many lookups per mapping. Set
+ * `ID_FILE_BENCH_DIR` to place the file on a disk other than `/tmp`.
+ */
+static void run_benchmarks(void) {
+  const char *max_env = getenv("ID_FILE_BENCH_MAX");
+  size_t n =
+      max_env != nullptr ? (size_t)strtod(max_env, nullptr) : 100000000;
+  const char *dir = getenv("ID_FILE_BENCH_DIR");
+  char path[256];
+  snprintf(path, sizeof(path), "%s/scru128-ids-XXXXXX",
+           dir != nullptr ? dir : "/tmp");
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  DeterministicGenerator g(VirtualClock(T, 1000), WyrandRandom(1));
+  std::vector<uint8_t> buf(16 << 16);
+  std::vector<Id> keys;
+  WyrandRandom rng(4);
+  for (size_t i = 0; i < n; i += 1 << 16) {
+    size_t count = std::min(n - i, (size_t)1 << 16);
+    for (size_t j = 0; j < count; j++) {
+      g.generate(&buf[16 * j]);
+      if (rng.next_u64() % (n / 100000 + 1) == 0) {
+        keys.push_back(Id::from_bytes(&buf[16 * j]));
+      }
+    }
+    assert(write(fd, buf.data(), 16 * count) == (ssize_t)(16 * count));
+  }
+  for (size_t i = keys.size(); i > 1; i--) {
+    std::swap(keys[i - 1], keys[rng.next_u64() % i]);
+  }
+  keys.resize(std::min(keys.size(), (size_t)100000));
+
+  auto lookup = [&keys](const IdFile &file, bool interpolation,
+                        size_t n_keys) {
+    size_t sum = 0;
+    for (size_t k = 0; k < n_keys; k++) {
+      const Id &key = keys[k];
+      if (interpolation) {
+        sum += file.lower_bound(key);
+      } else {
+        const uint8_t *lo = file.data();
+        for (size_t count = file.size(); count > 0;) {
+          size_t half = count / 2;
+          if (Id::from_bytes(lo + 16 * half) < key) {
+            lo += 16 * (half + 1);
+            count -= half + 1;
+          } else {
+            count = half;
+          }
+        }
+        sum += (size_t)(lo - file.data()) / 16;
+      }
+    }
+    return sum;
+  };
+  for (size_t n_keys : {std::max(keys.size() / 100, (size_t)1),
+                        keys.size()}) {
+    for (bool cold : {true, false}) {
+      for (bool interpolation : {true, false}) {
+        IdFile file;
+        if (cold) {
+          fdatasync(fd);
+          posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        } else {
+          // bring the pages to be touched into the page cache
+          assert(file.open(path) == 0);
+          volatile size_t primed = lookup(file, interpolation, n_keys);
+          (void)primed;
+        }
+        assert(file.open(path) == 0);
+        uint64_t faults = page_faults(), start = now_ns();
+        size_t sum = lookup(file, interpolation, n_keys);
+        double ns = (double)(now_ns() - start) / (double)n_keys;
+        double per_lookup = (double)(page_faults() - faults) / (double)n_keys;
+        printf("%zu IDs %6zu lookups %-4s %-13s %9.1f ns/lookup "
+               "%5.2f faults/lookup (%zu)\n",
+               n, n_keys, cold ? "cold" : "warm",
+               interpolation ? "interpolation" : "binary", ns, per_lookup,
+               sum % 10);
+      }
+    }
+  }
+  close(fd);
+  unlink(path);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_lookups();
+  test_open();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,156 @@
+/** id_format.hpp - std::format and fmt support for SCRU128 IDs
+ *
+ * Specializes `std::formatter` for `Id` where the standard library provides
+ * `<format>`, and `fmt::formatter` when compiled with `USE_FMT`:
+ *
+ *     std::format("{}", id);      // "0372hg16csmsm50l8dikcvukc"
+ *     fmt::format("{:U}", id);    // "0372HG16CSMSM50L8DIKCVUKC"
+ *     std::format("{:>27}", id);  // "  0372hg16csmsm50l8dikcvukc"
+ *
+ * Without fill, alignment, or width, the formatters encode the 25 digits
+ * straight into the output iterator of the format context, without a
+ * NUL-terminated temporary string to be measured and without any heap
+ * allocation.
+ */
+
+#ifndef SCRU128_ID_FORMAT_HPP
+#define SCRU128_ID_FORMAT_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+#include "codec.hpp"
+#include "id.hpp"
+
+#if __has_include(<format>)
+#include <format>
+#endif
+
+#ifdef USE_FMT
+#include <fmt/format.h>
+#endif
+
+namespace scru128 {
+
+/**
+ * Returns true if `OutputIt` is a `std::back_insert_iterator` into a container
+ * that can append a range of `char` in one call, such as `std::string` or the
+ * buffer behind `fmt::appender` (up to fmt 9).
+ */
+template <class OutputIt> constexpr bool is_appendable_inserter() {
+  if constexpr (requires { typename OutputIt::container_type; }) {
+    using Container = typename OutputIt::container_type;
+    return std::is_base_of_v<std::back_insert_iterator<Container>, OutputIt> &&
+           requires(Container &c, const char *p) { c.append(p, p); };
+  } else {
+    return false;
+  }
+}
+
+/**
+ * Returns the container of a `std::back_insert_iterator` (or of a class
+ * derived from it), which the iterator keeps in a protected member.
+ */
+template <class Container>
+constexpr Container &
+container_of(const std::back_insert_iterator<Container> &it) {
+  struct Accessor : std::back_insert_iterator<Container> {
+    static Container &get(const std::back_insert_iterator<Container> &it) {
+      return *(it.*&Accessor::container);
+    }
+  };
+  return Accessor::get(it);
+}
+
+/**
+ * Writes the 25 Base36 digits of an ID, without terminating NUL, to an output
+ * iterator. A `char *` receives the digits directly from `encode_words()`;
+ * a back-insert iterator into a container with `append()` receives them from
+ * a buffer on the stack in one block, and any other iterator one by one.
+ *
+ * @param out output iterator of `char`
+ * @param id ID to write
+ * @param upper true to write uppercase letters
+ * @return iterator past the last digit written
+ */
+template <class OutputIt>
+constexpr OutputIt encode_to(OutputIt out, const Id &id, bool upper = false) {
+  const char *digits = upper ? UPPER_DIGITS : DIGITS;
+  if constexpr (std::is_same_v<OutputIt, char *>) {
+    encode_words(id.hi, id.lo, out, digits);
+    return out + 25;
+  } else if constexpr (is_appendable_inserter<OutputIt>()) {
+    char buf[25];
+    encode_words(id.hi, id.lo, buf, digits);
+    container_of(out).append(buf, buf + 25);
+    return out;
+  } else {
+    char buf[25];
+    encode_words(id.hi, id.lo, buf, digits);
+    return std::copy_n(buf, 25, out);
+  }
+}
+
+/**
+ * Formatter shared by `std::formatter<Id>` and `fmt::formatter<Id>`.
+ *
+ * A format spec may start with `U`, for uppercase letters; the rest of the
+ * spec is that of strings (fill, alignment, and width) and is parsed by
+ * `StringFormatter`, the library's formatter of `std::string_view`, which
+ * throws on an invalid spec and thus turns a format string checked at compile
+ * time into a compile error. An empty spec (or `U` alone) takes a fast path
+ * that writes the digits to the output iterator with `encode_to()`; otherwise,
+ * the digits are encoded on the stack and handed to the same
+ * `StringFormatter`, which pads them.
+ */
+template <class StringFormatter> class IdFormatter {
+ public:
+  template <class ParseContext>
+  constexpr typename ParseContext::iterator parse(ParseContext &ctx) {
+    auto it = ctx.begin();
+    if (it != ctx.end() && *it == 'U') {
+      upper_ = true;
+      ctx.advance_to(++it);
+    }
+    plain_ = it == ctx.end() || *it == '}';
+    return plain_ ? it : string_formatter_.parse(ctx);
+  }
+
+  template <class FormatContext>
+  typename FormatContext::iterator format(const Id &id,
+                                          FormatContext &ctx) const {
+    if (plain_) {
+      return encode_to(ctx.out(), id, upper_);
+    }
+    char buf[25];
+    encode_words(id.hi, id.lo, buf, upper_ ? UPPER_DIGITS : DIGITS);
+    return string_formatter_.format(std::string_view(buf, 25), ctx);
+  }
+
+ private:
+  bool upper_ = false;
+  bool plain_ = false; // no fill, alignment, or width
+  StringFormatter string_formatter_;
+};
+
+} // namespace scru128
+
+#ifdef __cpp_lib_format
+namespace std {
+template <>
+struct formatter<scru128::Id>
+    : scru128::IdFormatter<formatter<std::string_view>> {};
+} // namespace std
+#endif /* #ifdef __cpp_lib_format */
+
+#ifdef USE_FMT
+namespace fmt {
+template <>
+struct formatter<scru128::Id>
+    : scru128::IdFormatter<formatter<std::string_view>> {};
+} // namespace fmt
+#endif /* #ifdef USE_FMT */
+
+#endif /* #ifndef SCRU128_ID_FORMAT_HPP */
@@ -0,0 +1,195 @@
+/** id_format_test.cpp - Tests for id_format.hpp
+ *
+ * Compile with `-DUSE_FMT -lfmt` to test `fmt::formatter<Id>` as well; the
+ * `std::formatter<Id>` tests run where the standard library has `<format>`.
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <iterator>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include "generator.hpp"
+#include "id.hpp"
+#include "id_format.hpp"
+
+using namespace scru128;
+
+static const Id ID = "0372hg16csmsm50l8dikcvukc"_scru128;
+
+/** Writes digits to pointers and to other output iterators. */
+static void test_encode_to(void) {
+  char text[32];
+  memset(text, '-', sizeof(text));
+  char *end = encode_to(text, ID);
+  assert(end == text + 25 && text[25] == '-');
+  assert(memcmp(text, "0372hg16csmsm50l8dikcvukc", 25) == 0);
+
+  std::string s = "id=";
+  encode_to(std::back_inserter(s), ID, true);
+  assert(s == "id=0372HG16CSMSM50L8DIKCVUKC");
+  static_assert(
+      is_appendable_inserter<std::back_insert_iterator<std::string>>());
+
+  std::vector<char> v(1, '>');
+  encode_to(std::back_inserter(v), ID);
+  assert(v.size() == 26 && memcmp(&v[1], "0372hg16csmsm50l8dikcvukc", 25) == 0);
+  static_assert(
+      !is_appendable_inserter<std::back_insert_iterator<std::vector<char>>>());
+
+  static_assert([] {
+    char out[25] = {};
+    encode_to(out, MAX_ID, true);
+    return out[0] == 'F' && out[24] == '3';
+  }());
+}
+
+#ifdef USE_FMT
+/** Formats IDs with fmt. */
+static void test_fmt(void) {
+  assert(fmt::format("{}", ID) == "0372hg16csmsm50l8dikcvukc");
+  assert(fmt::format("{:U}", ID) == "0372HG16CSMSM50L8DIKCVUKC");
+  assert(fmt::format("[{}] [{:U}]", MIN_ID, MAX_ID) ==
+         "[0000000000000000000000000] [F5LXX1ZZ5PNORYNQGLHZMSP33]");
+
+  fmt::memory_buffer buf;
+  fmt::format_to(std::back_inserter(buf), "id={} n={}", ID, 42);
+  assert(fmt::to_string(buf) == "id=0372hg16csmsm50l8dikcvukc n=42");
+
+  char line[16];
+  auto result = fmt::format_to_n(line, sizeof(line), "id={:U}", ID);
+  assert(result.size == 28);
+  assert(std::string(line, sizeof(line)) == "id=0372HG16CSMSM");
+
+  assert(fmt::format("{:>30}", ID) == "     0372hg16csmsm50l8dikcvukc");
+  assert(fmt::format("[{:U*<{}}]", ID, 27) ==
+         "[0372HG16CSMSM50L8DIKCVUKC**]");
+
+  bool thrown = false;
+  try {
+    (void)fmt::format(fmt::runtime("{:x}"), ID);
+  } catch (const fmt::format_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+#endif /* #ifdef USE_FMT */
+
+#ifdef __cpp_lib_format
+/** Formats IDs with std::format. */
+static void test_std_format(void) {
+  assert(std::format("{}", ID) == "0372hg16csmsm50l8dikcvukc");
+  assert(std::format("{:U}", ID) == "0372HG16CSMSM50L8DIKCVUKC");
+
+  char line[64];
+  auto result = std::format_to_n(line, sizeof(line), "id={}", MAX_ID);
+  assert(std::string(line, result.out) == "id=f5lxx1zz5pnorynqglhzmsp33");
+
+  assert(std::format("{:>30}", ID) == "     0372hg16csmsm50l8dikcvukc");
+  assert(std::format("[{:U*<{}}]", ID, 27) ==
+         "[0372HG16CSMSM50L8DIKCVUKC**]");
+
+  bool thrown = false;
+  try {
+    (void)std::vformat("{:x}", std::make_format_args(ID));
+  } catch (const std::format_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+#endif /* #ifdef __cpp_lib_format */
+
+#if defined(RUN_BENCHMARKS) && (defined(USE_FMT) || defined(__cpp_lib_format))
+static uint64_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1)) {
+    return p;
+  }
+  abort();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+#ifdef __cpp_lib_format
+namespace format_lib = std;
+#else
+namespace format_lib = fmt;
+#endif
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Formats log lines into a fixed buffer through a NUL-terminated temporary
+ * string and through the formatter, and counts heap allocations of each.
+ */
+static void run_benchmarks(void) {
+  const size_t N = 2000000;
+  std::vector<Id> ids(N);
+  Generator<> g;
+  for (Id &id : ids) {
+    g.generate(&id);
+  }
+  char line[128];
+  uint64_t sink = 0;
+
+  // take the best of five rounds to filter out noise
+  double temp_ns = 1e9, direct_ns = 1e9;
+  uint64_t temp_allocs = 0, direct_allocs = 0;
+  for (int round = 0; round < 5; round++) {
+    uint64_t allocs = allocations;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < N; i++) {
+      char text[26];
+      ids[i].encode(text);
+      auto r = format_lib::format_to_n(line, sizeof(line), "req {} id={} ok",
+                                       i, (const char *)text);
+      sink += (uint64_t)(r.out - line);
+    }
+    temp_ns = std::min(temp_ns, (double)(now_ns() - start) / N);
+    temp_allocs += allocations - allocs;
+
+    allocs = allocations;
+    start = now_ns();
+    for (size_t i = 0; i < N; i++) {
+      auto r = format_lib::format_to_n(line, sizeof(line), "req {} id={} ok",
+                                       i, ids[i]);
+      sink += (uint64_t)(r.out - line);
+    }
+    direct_ns = std::min(direct_ns, (double)(now_ns() - start) / N);
+    direct_allocs += allocations - allocs;
+  }
+
+  printf("log line via char[26]: %6.2f ns (%llu allocs)  "
+         "formatter: %6.2f ns (%llu allocs)  (%llu)\n",
+         temp_ns, (unsigned long long)temp_allocs, direct_ns,
+         (unsigned long long)direct_allocs, (unsigned long long)sink);
+}
+#endif /* #if defined(RUN_BENCHMARKS) && ... */
+
+int main(void) {
+  test_encode_to();
+#ifdef USE_FMT
+  test_fmt();
+#endif
+#ifdef __cpp_lib_format
+  test_std_format();
+#endif
+#if defined(RUN_BENCHMARKS) && (defined(USE_FMT) || defined(__cpp_lib_format))
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,406 @@
+/** id_log.hpp - Seekable block-compressed binary log of IDs
+ *
+ * A log is a sequence of blocks of `ID_LOG_BLOCK_SIZE` bytes, so that block
+ * `b` starts at byte `b * ID_LOG_BLOCK_SIZE` and can be read independently.
+ * Each block stores up to a few tens of thousands of IDs in three columns,
+ * followed by zero padding and a fixed-size footer at the end of the block:
+ *
+ * - timestamp column: the difference of each `timestamp` from the previous
+ *   one in the block (from zero for the first) as a zigzag LEB128 varint
+ * - counter column: the same for the 48-bit concatenation of `counter_hi`
+ *   and `counter_lo`
+ * - entropy column: `entropy` as raw 32-bit little-endian words
+ * - footer (`IdLogFooter`): magic number, number of IDs, byte lengths of the
+ *   first two columns, and the least and greatest `timestamp` in the block,
+ *   as little-endian integers
+ *
+ * IDs written by a generator repeat `timestamp` and increment `counter_lo`
+ * within a millisecond, so both differences mostly fit in one byte each and
+ * an ID takes about six bytes instead of 16, while `entropy`, which cannot be
+ * compressed, is kept raw. Out-of-order IDs are stored correctly, only less
+ * compactly.
+ */
+
+#ifndef SCRU128_ID_LOG_HPP
+#define SCRU128_ID_LOG_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+#include "id.hpp"
+
+namespace scru128 {
+
+/** Size in bytes of every block of a log. */
+constexpr size_t ID_LOG_BLOCK_SIZE = 1 << 16;
+
+/** Value of `IdLogFooter::magic` of a valid block. */
+constexpr uint32_t ID_LOG_MAGIC = 0x4c383231;
+
+/** Footer stored in the last `SIZE` bytes of each block. */
+struct IdLogFooter {
+  static constexpr size_t SIZE = 32;
+
+  uint32_t magic;
+  uint32_t count;
+  uint32_t timestamp_bytes;
+  uint32_t counter_bytes;
+  uint64_t min_timestamp;
+  uint64_t max_timestamp;
+
+  /** Writes the footer at the end of a block. */
+  void store(uint8_t *block) const {
+    uint8_t *p = block + ID_LOG_BLOCK_SIZE - SIZE;
+    store_le(p, magic, 4);
+    store_le(p + 4, count, 4);
+    store_le(p + 8, timestamp_bytes, 4);
+    store_le(p + 12, counter_bytes, 4);
+    store_le(p + 16, min_timestamp, 8);
+    store_le(p + 24, max_timestamp, 8);
+  }
+
+  /**
+   * Reads the footer at the end of a block and checks that it describes
+   * columns that fit in the block.
+   *
+   * @return zero on success or non-zero if the block is invalid
+   */
+  int load(const uint8_t *block) {
+    const uint8_t *p = block + ID_LOG_BLOCK_SIZE - SIZE;
+    magic = (uint32_t)load_le(p, 4);
+    count = (uint32_t)load_le(p + 4, 4);
+    timestamp_bytes = (uint32_t)load_le(p + 8, 4);
+    counter_bytes = (uint32_t)load_le(p + 12, 4);
+    min_timestamp = load_le(p + 16, 8);
+    max_timestamp = load_le(p + 24, 8);
+    uint64_t used = (uint64_t)timestamp_bytes + counter_bytes +
+                    4 * (uint64_t)count + SIZE;
+    return magic == ID_LOG_MAGIC && used <= ID_LOG_BLOCK_SIZE ? 0 : -1;
+  }
+
+  static void store_le(uint8_t *p, uint64_t value, int len) {
+    for (int i = 0; i < len; i++) {
+      p[i] = (uint8_t)(value >> (8 * i));
+    }
+  }
+
+  static uint64_t load_le(const uint8_t *p, int len) {
+    uint64_t value = 0;
+    for (int i = len - 1; i >= 0; i--) {
+      value = value << 8 | p[i];
+    }
+    return value;
+  }
+};
+
+/** Returns the greatest number of IDs a block holds, at 6 bytes per ID. */
+constexpr size_t max_block_ids() {
+  return (ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE) / 6;
+}
+
+/** Writes the zigzag LEB128 varint of `delta` and returns its length. */
+inline size_t put_varint(int64_t delta, uint8_t *out) {
+  uint64_t v = (uint64_t)delta << 1 ^ (uint64_t)(delta >> 63);
+  size_t len = 0;
+  while (v >= 0x80) {
+    out[len++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[len++] = (uint8_t)v;
+  return len;
+}
+
+/**
+ * Reads a zigzag LEB128 varint at `*p`, not reading at or beyond `end`, and
+ * advances `*p` past it.
+ *
+ * @return zero on success or non-zero if the varint runs past `end`
+ */
+inline int get_varint(const uint8_t **p, const uint8_t *end, int64_t *delta) {
+  const uint8_t *q = *p;
+  uint64_t v;
+  if (q < end && *q < 0x80) {
+    v = *q++; // most differences take one byte
+  } else {
+    v = 0;
+    for (int shift = 0;; shift += 7) {
+      if (q == end || shift > 63) {
+        return -1;
+      }
+      uint8_t byte = *q++;
+      v |= (uint64_t)(byte & 0x7f) << shift;
+      if (byte < 0x80) {
+        break;
+      }
+    }
+  }
+  *p = q;
+  *delta = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  return 0;
+}
+
+/**
+ * Decodes a block of a log.
+ *
+ * @param block `ID_LOG_BLOCK_SIZE`-byte block
+ * @param footer receives the footer of the block
+ * @param out receives `footer->count` IDs; must hold `max_block_ids()`
+ * @return zero on success or non-zero if the block is invalid
+ */
+inline int decode_id_log_block(const uint8_t *block, IdLogFooter *footer,
+                               Id *out) {
+  if (footer->load(block) != 0 || footer->count > max_block_ids()) {
+    return -1;
+  }
+  const uint8_t *ts_pos = block, *ts_end = block + footer->timestamp_bytes;
+  const uint8_t *counter_pos = ts_end;
+  const uint8_t *counter_end = counter_pos + footer->counter_bytes;
+  const uint8_t *entropy = counter_end;
+  uint64_t ts = 0, counter = 0;
+  for (uint32_t i = 0; i < footer->count; i++) {
+    int64_t ts_delta, counter_delta;
+    if (get_varint(&ts_pos, ts_end, &ts_delta) != 0 ||
+        get_varint(&counter_pos, counter_end, &counter_delta) != 0) {
+      return -1;
+    }
+    ts += (uint64_t)ts_delta;
+    counter += (uint64_t)counter_delta;
+    uint32_t e;
+    memcpy(&e, entropy + 4 * i, 4);
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    e = __builtin_bswap32(e);
+#endif
+    out[i] = Id{ts << 16 | (counter >> 32 & 0xffff),
+                counter << 32 | e};
+  }
+  return ts_pos == ts_end && counter_pos == counter_end ? 0 : -1;
+}
+
+/**
+ * Writes IDs to a log through a file descriptor, one block at a time.
+ *
+ * The writer has the `write()` method of the sinks of `StreamMerger` (see
+ * `merge.hpp`), so that merged streams can be written straight to a log.
+ * `flush()` must be called after the last ID, as buffered IDs are not written
+ * on destruction, where errors could not be reported; a block written by
+ * `flush()` is padded, and further IDs start a new block.
+ */
+class IdLogWriter {
+ public:
+  /**
+   * @param fd file descriptor to write, which is not closed
+   */
+  explicit IdLogWriter(int fd) : fd_(fd), block_(ID_LOG_BLOCK_SIZE) {
+    reset();
+  }
+
+  /** Appends `n` IDs and returns zero on success or -1 on failure. */
+  int write(const Id *in, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      uint64_t ts = in[i].timestamp();
+      uint64_t counter = (in[i].hi & 0xffff) << 32 | in[i].lo >> 32;
+      uint8_t ts_bytes[10], counter_bytes[10];
+      size_t ts_len = put_varint((int64_t)(ts - ts_), ts_bytes);
+      size_t counter_len =
+          put_varint((int64_t)(counter - counter_), counter_bytes);
+      if (ts_col_.size() + ts_len + counter_col_.size() + counter_len +
+              4 * (count_ + 1) + IdLogFooter::SIZE >
+          ID_LOG_BLOCK_SIZE) {
+        if (write_block() != 0) {
+          return -1;
+        }
+        // start over from zero in the new block
+        ts_len = put_varint((int64_t)ts, ts_bytes);
+        counter_len = put_varint((int64_t)counter, counter_bytes);
+      }
+      ts_col_.insert(ts_col_.end(), ts_bytes, ts_bytes + ts_len);
+      counter_col_.insert(counter_col_.end(), counter_bytes,
+                          counter_bytes + counter_len);
+      uint8_t *e = &block_[ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE -
+                           4 * max_block_ids() + 4 * count_];
+      IdLogFooter::store_le(e, (uint32_t)in[i].lo, 4);
+      min_ts_ = ts < min_ts_ ? ts : min_ts_;
+      max_ts_ = ts > max_ts_ ? ts : max_ts_;
+      ts_ = ts;
+      counter_ = counter;
+      count_++;
+      ids_++;
+    }
+    return 0;
+  }
+
+  /** Writes the buffered IDs, if any, and returns zero or -1 on failure. */
+  int flush() { return count_ > 0 ? write_block() : 0; }
+
+  /** Returns the number of IDs appended. */
+  uint64_t ids() const { return ids_; }
+
+  /** Returns the number of blocks written. */
+  uint64_t blocks() const { return blocks_; }
+
+ private:
+  void reset() {
+    ts_col_.clear();
+    counter_col_.clear();
+    count_ = 0;
+    ts_ = 0;
+    counter_ = 0;
+    min_ts_ = UINT64_MAX;
+    max_ts_ = 0;
+  }
+
+  /** Lays out the columns of the buffered IDs in a block and writes it. */
+  int write_block() {
+    uint8_t *block = block_.data();
+    // the entropy column is buffered at the end of the block; move it to
+    // follow the other columns
+    const uint8_t *entropy = block + ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE -
+                             4 * max_block_ids();
+    size_t entropy_at = ts_col_.size() + counter_col_.size();
+    memmove(block + entropy_at, entropy, 4 * count_);
+    memcpy(block, ts_col_.data(), ts_col_.size());
+    memcpy(block + ts_col_.size(), counter_col_.data(), counter_col_.size());
+    memset(block + entropy_at + 4 * count_, 0,
+           ID_LOG_BLOCK_SIZE - entropy_at - 4 * count_);
+    IdLogFooter footer = {ID_LOG_MAGIC, (uint32_t)count_,
+                          (uint32_t)ts_col_.size(),
+                          (uint32_t)counter_col_.size(), min_ts_, max_ts_};
+    footer.store(block);
+    for (size_t done = 0; done < ID_LOG_BLOCK_SIZE;) {
+      ssize_t r = ::write(fd_, block + done, ID_LOG_BLOCK_SIZE - done);
+      if (r < 0) {
+        return -1;
+      }
+      done += (size_t)r;
+    }
+    blocks_++;
+    reset();
+    return 0;
+  }
+
+  int fd_;
+  std::vector<uint8_t> block_; // entropy column buffered at the end
+  std::vector<uint8_t> ts_col_;
+  std::vector<uint8_t> counter_col_;
+  size_t count_;
+  uint64_t ts_;
+  uint64_t counter_;
+  uint64_t min_ts_;
+  uint64_t max_ts_;
+  uint64_t ids_ = 0;
+  uint64_t blocks_ = 0;
+};
+
+/**
+ * Reads IDs from a log through a file descriptor, decoding a block at a time.
+ *
+ * The reader has the `read()` method of the sources of `StreamMerger` (see
+ * `merge.hpp`). On a seekable file, `seek_timestamp()` finds a position by
+ * the footers of the blocks without decoding them.
+ */
+class IdLogReader {
+ public:
+  /**
+   * @param fd file descriptor to read, which is not closed
+   */
+  explicit IdLogReader(int fd)
+      : fd_(fd), block_(ID_LOG_BLOCK_SIZE), ids_(max_block_ids()) {}
+
+  /**
+   * Reads up to `max` next IDs.
+   *
+   * @return number of IDs read, zero at the end, or -1 on error, including an
+   * invalid or truncated block
+   */
+  ssize_t read(Id *out, size_t max) {
+    while (pos_ == count_) {
+      int r = next_block();
+      if (r <= 0) {
+        return r;
+      }
+    }
+    size_t n = max < count_ - pos_ ? max : count_ - pos_;
+    memcpy(out, &ids_[pos_], n * sizeof(Id));
+    pos_ += n;
+    return (ssize_t)n;
+  }
+
+  /**
+   * Moves to the first ID whose `timestamp` is not less than `t`, assuming
+   * that the log is in the order of `timestamp`, by a binary search over the
+   * footers of the blocks. The file must be seekable.
+   *
+   * @return zero on success or non-zero on failure
+   */
+  int seek_timestamp(uint64_t t) {
+    off_t size = lseek(fd_, 0, SEEK_END);
+    if (size < 0) {
+      return -1;
+    }
+    // find the first block whose greatest `timestamp` is not less than `t`
+    uint64_t lo = 0, hi = (uint64_t)size / ID_LOG_BLOCK_SIZE;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      IdLogFooter footer;
+      uint8_t *at = block_.data() + ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE;
+      if (pread(fd_, at, IdLogFooter::SIZE,
+                (off_t)((mid + 1) * ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE)) !=
+              (ssize_t)IdLogFooter::SIZE ||
+          footer.load(block_.data()) != 0) {
+        return -1;
+      }
+      if (footer.max_timestamp < t) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lseek(fd_, (off_t)(lo * ID_LOG_BLOCK_SIZE), SEEK_SET) < 0) {
+      return -1;
+    }
+    pos_ = count_ = 0;
+    if (next_block() < 0) {
+      return -1;
+    }
+    while (pos_ < count_ && ids_[pos_].timestamp() < t) {
+      pos_++;
+    }
+    return 0;
+  }
+
+ private:
+  /** Reads and decodes the next block and returns 1, zero at the end, or -1. */
+  int next_block() {
+    size_t len = 0;
+    while (len < ID_LOG_BLOCK_SIZE) {
+      ssize_t r = ::read(fd_, block_.data() + len, ID_LOG_BLOCK_SIZE - len);
+      if (r < 0) {
+        return -1;
+      } else if (r == 0) {
+        return len == 0 ? 0 : -1; // a partial block at the end is invalid
+      }
+      len += (size_t)r;
+    }
+    IdLogFooter footer;
+    if (decode_id_log_block(block_.data(), &footer, ids_.data()) != 0) {
+      return -1;
+    }
+    pos_ = 0;
+    count_ = footer.count;
+    return 1;
+  }
+
+  int fd_;
+  std::vector<uint8_t> block_;
+  std::vector<Id> ids_;
+  size_t pos_ = 0;
+  size_t count_ = 0;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_ID_LOG_HPP */
@@ -0,0 +1,199 @@
+/** id_log_test.cpp - Tests for id_log.hpp */
+
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "id.hpp"
+#include "id_log.hpp"
+#include "random.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+/** Writes IDs to a log and returns its size in bytes. */
+static size_t write_log(int fd, const std::vector<Id> &ids, size_t batch) {
+  IdLogWriter writer(fd);
+  for (size_t i = 0; i < ids.size(); i += batch) {
+    assert(writer.write(&ids[i], std::min(batch, ids.size() - i)) == 0);
+  }
+  assert(writer.flush() == 0);
+  assert(writer.ids() == ids.size());
+  struct stat st;
+  assert(fstat(fd, &st) == 0);
+  assert((size_t)st.st_size == writer.blocks() * ID_LOG_BLOCK_SIZE);
+  return (size_t)st.st_size;
+}
+
+/** Reads a log from the start to the end. */
+static std::vector<Id> read_log(int fd, size_t batch) {
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  IdLogReader reader(fd);
+  std::vector<Id> ids, buf(batch);
+  ssize_t n;
+  while ((n = reader.read(buf.data(), batch)) > 0) {
+    ids.insert(ids.end(), buf.begin(), buf.begin() + n);
+  }
+  assert(n == 0);
+  return ids;
+}
+
+/** Round-trips IDs in and out of generator order. */
+static void test_round_trip(void) {
+  for (uint64_t ids_per_ms : {1, 10, 1000, 100000}) {
+    std::vector<Id> ids = generate_ids(100000, ids_per_ms);
+    int fd = temp_file();
+    size_t size = write_log(fd, ids, 777);
+    assert(read_log(fd, 1000) == ids);
+    if (ids_per_ms >= 10) {
+      assert(2 * size < 16 * ids.size()); // at least 2x smaller
+    }
+    close(fd);
+  }
+
+  // random IDs, including extremes, take long differences of both signs
+  WyrandRandom rng(2);
+  std::vector<Id> ids(50000);
+  for (Id &id : ids) {
+    id = Id{rng.next_u64(), rng.next_u64()};
+  }
+  ids[10] = MAX_ID;
+  ids[11] = MIN_ID;
+  ids[12] = MAX_ID;
+  int fd = temp_file();
+  write_log(fd, ids, 50000);
+  assert(read_log(fd, 7) == ids);
+  close(fd);
+
+  // flushing in the middle starts a new block; an empty log has no blocks
+  fd = temp_file();
+  IdLogWriter writer(fd);
+  std::vector<Id> more = generate_ids(30, 3);
+  assert(writer.write(more.data(), 10) == 0 && writer.flush() == 0);
+  assert(writer.write(more.data() + 10, 20) == 0 && writer.flush() == 0);
+  assert(writer.flush() == 0 && writer.blocks() == 2);
+  assert(read_log(fd, 4) == more);
+  close(fd);
+  fd = temp_file();
+  assert(write_log(fd, {}, 1) == 0 && read_log(fd, 1).empty());
+  close(fd);
+}
+
+/** Seeks to timestamps by the footers of blocks. */
+static void test_seek(void) {
+  std::vector<Id> ids = generate_ids(200000, 50);
+  int fd = temp_file();
+  write_log(fd, ids, 1000);
+  IdLogReader reader(fd);
+  for (uint64_t t : {(uint64_t)0, T, T + 1, T + 1234, T + 3999, T + 4000,
+                     T + 99999}) {
+    assert(reader.seek_timestamp(t) == 0);
+    size_t expected = 0;
+    while (expected < ids.size() && ids[expected].timestamp() < t) {
+      expected++;
+    }
+    Id id;
+    ssize_t n = reader.read(&id, 1);
+    assert(n == (expected < ids.size() ? 1 : 0));
+    assert(n == 0 || id == ids[expected]);
+  }
+  close(fd);
+}
+
+/** Rejects blocks that are corrupt or truncated. */
+static void test_invalid(void) {
+  std::vector<Id> ids = generate_ids(30000, 100);
+  int fd = temp_file();
+  size_t size = write_log(fd, ids, 30000);
+  std::vector<uint8_t> block(ID_LOG_BLOCK_SIZE);
+  assert(pread(fd, block.data(), block.size(), 0) == (ssize_t)block.size());
+
+  IdLogFooter footer;
+  std::vector<Id> out(max_block_ids());
+  assert(decode_id_log_block(block.data(), &footer, out.data()) == 0);
+  assert(footer.min_timestamp == T && footer.max_timestamp >= T);
+  assert(std::equal(out.begin(), out.begin() + footer.count, ids.begin()));
+
+  std::vector<uint8_t> bad(block);
+  bad[ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE] ^= 1; // magic
+  assert(decode_id_log_block(bad.data(), &footer, out.data()) != 0);
+  bad = block;
+  bad[ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE + 8]++; // timestamp_bytes
+  assert(decode_id_log_block(bad.data(), &footer, out.data()) != 0);
+  bad = block;
+  bad[ID_LOG_BLOCK_SIZE - IdLogFooter::SIZE + 5] = 0xff; // count
+  assert(decode_id_log_block(bad.data(), &footer, out.data()) != 0);
+  bad = block;
+  memset(bad.data(), 0xff, 64); // overlong varints
+  assert(decode_id_log_block(bad.data(), &footer, out.data()) != 0);
+
+  assert(ftruncate(fd, (off_t)(size - 1)) == 0);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  IdLogReader reader(fd);
+  std::vector<Id> buf(1000);
+  ssize_t n;
+  while ((n = reader.read(buf.data(), buf.size())) > 0) {
+  }
+  assert(n == -1);
+  close(fd);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Measures the size, encoding, and decoding (from memory, in bytes of 16-byte
+ * IDs per second) of logs of 10 million IDs at 10-10000 IDs per millisecond.
+ */
+static void run_benchmarks(void) {
+  const size_t N = 10000000;
+  for (uint64_t ids_per_ms : {10, 1000, 10000}) {
+    std::vector<Id> ids = generate_ids(N, ids_per_ms);
+    int fd = temp_file();
+    uint64_t start = now_ns();
+    size_t size = write_log(fd, ids, 4096);
+    double encode_ns = (double)(now_ns() - start);
+
+    std::vector<uint8_t> log(size);
+    assert(pread(fd, log.data(), size, 0) == (ssize_t)size);
+    close(fd);
+    std::vector<Id> out(N + max_block_ids());
+    start = now_ns();
+    size_t n = 0;
+    for (size_t b = 0; b < size; b += ID_LOG_BLOCK_SIZE) {
+      IdLogFooter footer;
+      decode_id_log_block(&log[b], &footer, &out[n]);
+      n += footer.count;
+    }
+    double decode_ns = (double)(now_ns() - start);
+    assert(n == N && std::equal(ids.begin(), ids.end(), out.begin()));
+
+    printf("%5llu IDs/ms  %5.2f bytes/ID (%4.2fx)  encode: %5.2f GB/s  "
+           "decode: %5.2f GB/s\n",
+           (unsigned long long)ids_per_ms, (double)size / N,
+           16.0 * N / (double)size, 16.0 * N / encode_ns,
+           16.0 * N / decode_ns);
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_round_trip();
+  test_seek();
+  test_invalid();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
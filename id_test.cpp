@@ -0,0 +1,196 @@
+/** id_test.cpp - Tests for id.hpp */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <type_traits>
+#include <vector>
+
+#include "codec.hpp"
+#include "generator.hpp"
+#include "id.hpp"
+
+using namespace scru128;
+
+static_assert(std::is_trivially_copyable_v<Id>);
+static_assert(std::is_standard_layout_v<Id>);
+
+/** Converts IDs between text, bytes, words, and 128-bit integers. */
+static void test_conversions(void) {
+  struct TestCase {
+    uint8_t bytes[16];
+    char text[26];
+    uint64_t timestamp;
+    uint32_t counter_hi, counter_lo, entropy;
+  };
+
+  const struct TestCase test_vector[] = {
+      {{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+       "0000000000000000000000000",
+       0,
+       0,
+       0,
+       0},
+      {{0x01, 0x7f, 0xee, 0x7f, 0xef, 0x41, 0x7e, 0x2b, 0x34, 0x32, 0xac, 0x2e,
+        0xc5, 0x53, 0x68, 0x7c},
+       "0372hg16csmsm50l8dikcvukc",
+       0x017fee7fef41,
+       0x7e2b34,
+       0x32ac2e,
+       0xc553687c},
+      {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff},
+       "f5lxx1zz5pnorynqglhzmsp33",
+       0xffffffffffff,
+       0xffffff,
+       0xffffff,
+       0xffffffff}};
+
+  for (const struct TestCase &e : test_vector) {
+    Id id = Id::from_bytes(e.bytes);
+    assert(id.timestamp() == e.timestamp);
+    assert(id.counter_hi() == e.counter_hi);
+    assert(id.counter_lo() == e.counter_lo);
+    assert(id.entropy() == e.entropy);
+    assert(id == Id::from_fields(e.timestamp, e.counter_hi, e.counter_lo,
+                                 e.entropy));
+    assert(id == Id::from_u128(id.to_u128()));
+
+    uint8_t bytes[16];
+    id.to_bytes(bytes);
+    assert(memcmp(bytes, e.bytes, 16) == 0);
+
+    char text[26];
+    id.encode(text);
+    assert(memcmp(text, e.text, 26) == 0);
+
+    Id decoded;
+    assert(Id::decode(e.text, &decoded) == 0);
+    assert(decoded == id);
+  }
+
+  Id id;
+  assert(Id::decode("0372hg16csmsm50l8dikcvukc0", &id) != 0);
+  assert(Id::decode("f5lxx1zz5pnorynqglhzmsp34", &id) != 0);
+}
+
+/** Orders IDs as their binary forms are ordered. */
+static void test_ordering(void) {
+  Generator<> g;
+  std::vector<Id> ids(10000);
+  for (Id &id : ids) {
+    assert(g.generate(&id) == 0);
+  }
+  for (size_t i = 1; i < ids.size(); i++) {
+    assert(ids[i - 1] < ids[i]);
+    assert(ids[i] > ids[i - 1]);
+    assert(ids[i - 1] != ids[i]);
+
+    uint8_t a[16], b[16];
+    ids[i - 1].to_bytes(a);
+    ids[i].to_bytes(b);
+    assert(memcmp(a, b, 16) < 0);
+  }
+
+  Id small = Id::from_u128((unsigned __int128)1 << 64);
+  Id large = Id::from_u128(((unsigned __int128)1 << 64) | 1);
+  assert(small < large && (small <=> large) < 0);
+  assert(Id::from_u128(~(unsigned __int128)0) > large);
+}
+
+/** Returns true if `id` encodes to `text`, for use in constant expressions. */
+static constexpr bool encodes_to(Id id, const char *text) {
+  char out[26] = {};
+  id.encode(out);
+  for (int i = 0; i < 26; i++) {
+    if (out[i] != text[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Converts literals and text at compile time. Invalid literals such as
+ * `"0372hg16csmsm50l8dikcvuk+"_scru128` do not compile and cannot be tested
+ * here.
+ */
+static void test_literals(void) {
+  constexpr Id id = "0372hg16csmsm50l8dikcvukc"_scru128;
+  static_assert(id.timestamp() == 0x017fee7fef41);
+  static_assert(id.counter_hi() == 0x7e2b34 && id.counter_lo() == 0x32ac2e);
+  static_assert(id.entropy() == 0xc553687c);
+  static_assert(encodes_to(id, "0372hg16csmsm50l8dikcvukc"));
+  static_assert("0372HG16CSMSM50L8DIKCVUKC"_scru128 == id);
+
+  static_assert(MIN_ID == Id{0, 0} && MIN_ID.is_reserved());
+  static_assert(MAX_ID == Id::from_u128(~(unsigned __int128)0));
+  static_assert(MAX_ID.is_reserved() && !id.is_reserved());
+  static_assert(Id::from_fields(1, 0, 0, 0).is_reserved() == false);
+
+  static_assert([] {
+    Id out = {0, 0};
+    return Id::decode("0372hg16csmsm50l8dikcvukc", &out) == 0 &&
+           out == "0372hg16csmsm50l8dikcvukc"_scru128;
+  }());
+  static_assert([] {
+    Id out = {0, 0};
+    return Id::decode("0372hg16csmsm50l8dikcvuk", &out) != 0 &&
+           Id::decode("f5lxx1zz5pnorynqglhzmsp34", &out) != 0;
+  }());
+
+  // the same conversions at run time
+  Id out;
+  assert(Id::decode("0372hg16csmsm50l8dikcvukc", &out) == 0 && out == id);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Compares round trips through the byte array and the native type. */
+static void run_benchmarks(void) {
+  const size_t N = 4000000;
+  std::vector<Id> ids(N);
+  Generator<> g;
+  for (Id &id : ids) {
+    g.generate(&id);
+  }
+  std::vector<char> text(26 * N);
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    uint8_t bytes[16];
+    ids[i].to_bytes(bytes);
+    encode(bytes, &text[26 * i]);
+    decode(&text[26 * i], bytes);
+    ids[i] = Id::from_bytes(bytes);
+  }
+  double bytes_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    ids[i].encode(&text[26 * i]);
+    Id::decode(&text[26 * i], &ids[i]);
+  }
+  double native_ns = (double)(now_ns() - start) / N;
+
+  printf("encode + decode via bytes: %6.2f ns/id  native: %6.2f ns/id\n",
+         bytes_ns, native_ns);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_conversions();
+  test_ordering();
+  test_literals();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
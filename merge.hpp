@@ -0,0 +1,537 @@
+/** merge.hpp - K-way merge of sorted streams of IDs from many nodes */
+
+#ifndef SCRU128_MERGE_HPP
+#define SCRU128_MERGE_HPP
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "codec.hpp"
+#include "id.hpp"
+
+namespace scru128 {
+
+/**
+ * Tournament tree of losers over `k` inputs for a k-way merge.
+ *
+ * Each internal node keeps the input that lost the match played there, and
+ * the overall winner is kept above the root, so that replacing the head of
+ * the winning input replays only the matches on the path from its leaf to
+ * the root: `log2(k)` comparisons with one fixed opponent each, against about
+ * twice as many with branching for a binary heap. Exhausted inputs lose to
+ * every live one.
+ */
+class LoserTree {
+ public:
+  /**
+   * Builds the tree over the heads of `k` inputs.
+   *
+   * @param heads `k` first IDs of the inputs
+   * @param live `k` flags, zero if the input is empty
+   * @param k number of inputs; at least one
+   */
+  void build(const Id *heads, const uint8_t *live, size_t k) {
+    keys_.assign(heads, heads + k);
+    live_.assign(live, live + k);
+    nodes_.assign(k, 0);
+    // leaf `i` is node `k + i` of a complete binary tree with `2k - 1` nodes
+    std::vector<uint32_t> winners(2 * k);
+    for (size_t i = 0; i < k; i++) {
+      winners[k + i] = (uint32_t)i;
+    }
+    for (size_t node = k - 1; node >= 1; node--) {
+      uint32_t a = winners[2 * node], b = winners[2 * node + 1];
+      if (less(b, a)) {
+        std::swap(a, b);
+      }
+      winners[node] = a;
+      nodes_[node] = b;
+    }
+    nodes_[0] = k > 1 ? winners[1] : 0;
+  }
+
+  /** Returns true if all inputs are exhausted. */
+  bool empty() const { return !live_[nodes_[0]]; }
+
+  /** Returns the index of the input holding the least head. */
+  size_t winner() const { return nodes_[0]; }
+
+  /** Returns the least head. */
+  const Id &top() const { return keys_[nodes_[0]]; }
+
+  /** Replaces the least head with the next ID of the same input. */
+  void replace_top(const Id &next) {
+    keys_[nodes_[0]] = next;
+    replay(nodes_[0]);
+  }
+
+  /** Marks the input holding the least head as exhausted. */
+  void pop_top() {
+    live_[nodes_[0]] = false;
+    replay(nodes_[0]);
+  }
+
+ private:
+  bool less(uint32_t a, uint32_t b) const {
+    return live_[a] && (!live_[b] || keys_[a] < keys_[b]);
+  }
+
+  void replay(uint32_t winner) {
+    size_t k = keys_.size();
+    for (size_t node = (k + winner) / 2; node >= 1; node /= 2) {
+      // select without branching, as the outcome of each match is random
+      uint32_t loser = nodes_[node];
+      bool swap = less(loser, winner);
+      nodes_[node] = swap ? winner : loser;
+      winner = swap ? loser : winner;
+    }
+    nodes_[0] = winner;
+  }
+
+  std::vector<Id> keys_;
+  std::vector<uint8_t> live_;
+  std::vector<uint32_t> nodes_; // winner at 0 and losers at 1 to k - 1
+};
+
+/** Source that reads IDs from a sorted array in memory. */
+class ArraySource {
+ public:
+  ArraySource(const Id *ids, size_t n) : ids_(ids), n_(n) {}
+
+  /**
+   * Reads up to `max` next IDs.
+   *
+   * @return number of IDs read, zero at the end, or -1 on error
+   */
+  ssize_t read(Id *out, size_t max) {
+    size_t n = max < n_ - pos_ ? max : n_ - pos_;
+    std::copy(ids_ + pos_, ids_ + pos_ + n, out);
+    pos_ += n;
+    return (ssize_t)n;
+  }
+
+ private:
+  const Id *ids_;
+  size_t n_;
+  size_t pos_ = 0;
+};
+
+/**
+ * Source that reads text IDs (one per line, optionally followed by CR) or
+ * 16-byte binary IDs from a file descriptor through a buffer of fixed size.
+ * Lines that cannot be decoded, including lines longer than the buffer, and
+ * a trailing partial binary record are skipped and counted.
+ */
+class FdSource {
+ public:
+  /**
+   * @param fd file descriptor to read, which is not closed
+   * @param binary true for 16-byte binary IDs or false for text
+   * @param buffer_size size of the read buffer in bytes (at least 32), which
+   * is also the length beyond which a line is skipped as invalid
+   */
+  FdSource(int fd, bool binary, size_t buffer_size = 1 << 16)
+      : fd_(fd), binary_(binary), buf_(buffer_size > 32 ? buffer_size : 32) {}
+
+  /**
+   * Reads up to `max` next IDs.
+   *
+   * @return number of IDs read, zero at the end, or -1 on error
+   */
+  ssize_t read(Id *out, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      const char *p = buf_.data() + pos_;
+      size_t avail = len_ - pos_;
+      if (binary_ && avail >= 16) {
+        out[n++] = Id::from_bytes((const uint8_t *)p);
+        pos_ += 16;
+        continue;
+      }
+      const char *eol =
+          binary_ ? nullptr : (const char *)memchr(p, '\n', avail);
+      if (eol != nullptr) {
+        if (skipping_) {
+          skipping_ = false; // the rest of a line already counted as invalid
+        } else {
+          n += parse_line(p, (size_t)(eol - p), &out[n]);
+        }
+        pos_ += (size_t)(eol - p) + 1;
+        continue;
+      }
+      if (skipping_ || (!binary_ && avail == buf_.size())) {
+        // count an overlong line as an invalid record and skip the rest of it
+        invalid_ += !skipping_;
+        skipping_ = true;
+        pos_ = len_;
+      }
+      if (n > 0 || eof_) {
+        break; // hand over what has been read before blocking again
+      }
+      if (refill() != 0) {
+        return -1;
+      }
+      if (eof_ && pos_ < len_) {
+        // the last line without a line break, or a partial binary record
+        if (binary_) {
+          invalid_++;
+        } else if (!skipping_) {
+          n += parse_line(buf_.data() + pos_, len_ - pos_, &out[n]);
+        }
+        pos_ = len_;
+      }
+    }
+    return (ssize_t)n;
+  }
+
+  /** Returns the number of records skipped as invalid. */
+  uint64_t invalid() const { return invalid_; }
+
+ private:
+  /** Decodes a line into `out` and returns one, or zero if it is invalid. */
+  size_t parse_line(const char *line, size_t len, Id *out) {
+    if (len > 0 && line[len - 1] == '\r') {
+      len--;
+    }
+    if (len != 25 || decode_words(line, &out->hi, &out->lo) != 0) {
+      invalid_++;
+      return 0;
+    }
+    return 1;
+  }
+
+  /** Reads more bytes after the unconsumed ones and returns zero or -1. */
+  int refill() {
+    memmove(buf_.data(), buf_.data() + pos_, len_ - pos_);
+    len_ -= pos_;
+    pos_ = 0;
+    ssize_t r = ::read(fd_, buf_.data() + len_, buf_.size() - len_);
+    if (r < 0) {
+      return -1;
+    }
+    eof_ = r == 0;
+    len_ += (size_t)r;
+    return 0;
+  }
+
+  int fd_;
+  bool binary_;
+  bool eof_ = false;
+  std::vector<char> buf_;
+  size_t pos_ = 0; // first unconsumed byte in `buf_`
+  size_t len_ = 0; // bytes held in `buf_`
+  uint64_t invalid_ = 0;
+  bool skipping_ = false; // within a line longer than `buf_`
+};
+
+/** Sink that appends IDs to a vector. */
+struct VectorSink {
+  std::vector<Id> ids;
+
+  /** Writes `n` IDs and returns zero. */
+  int write(const Id *in, size_t n) {
+    ids.insert(ids.end(), in, in + n);
+    return 0;
+  }
+};
+
+/**
+ * Sink that writes text IDs (lowercase, one per line) or 16-byte binary IDs
+ * to a file descriptor.
+ */
+class FdSink {
+ public:
+  /**
+   * @param fd file descriptor to write, which is not closed
+   * @param binary true for 16-byte binary IDs or false for text
+   */
+  FdSink(int fd, bool binary) : fd_(fd), binary_(binary) {}
+
+  /** Writes `n` IDs and returns zero on success or -1 on failure. */
+  int write(const Id *in, size_t n) {
+    size_t record = binary_ ? 16 : 26;
+    buf_.resize(record * n);
+    for (size_t i = 0; i < n; i++) {
+      char *p = &buf_[record * i];
+      if (binary_) {
+        in[i].to_bytes((uint8_t *)p);
+      } else {
+        encode_words(in[i].hi, in[i].lo, p);
+        p[25] = '\n';
+      }
+    }
+    for (size_t done = 0; done < buf_.size();) {
+      ssize_t r = ::write(fd_, buf_.data() + done, buf_.size() - done);
+      if (r < 0) {
+        return -1;
+      }
+      done += (size_t)r;
+    }
+    return 0;
+  }
+
+ private:
+  int fd_;
+  bool binary_;
+  std::vector<char> buf_;
+};
+
+/**
+ * Merges many individually sorted streams of IDs, such as those collected
+ * from each node, into one sorted stream with a `LoserTree`.
+ *
+ * Memory is bounded regardless of the length of the streams: each input is
+ * read through a block of `block_size` IDs and the output is written in
+ * blocks of the same size. With `dedup`, an ID equal to the previous output
+ * is dropped and counted, which finds every duplicate because equal IDs are
+ * adjacent in the merged order. An ID less than its predecessor in the same
+ * input breaks the order of the output and is counted as unordered.
+ *
+ * Sources have `ssize_t read(Id *out, size_t max)`, which returns the number
+ * of IDs read, zero at the end, or -1 on error (see `ArraySource` and
+ * `FdSource`), and sinks have `int write(const Id *in, size_t n)`, which
+ * returns zero on success (see `VectorSink` and `FdSink`).
+ */
+class StreamMerger {
+ public:
+  /**
+   * @param dedup true to drop duplicate IDs
+   * @param block_size number of IDs buffered per input and for the output
+   */
+  explicit StreamMerger(bool dedup = false, size_t block_size = 1024)
+      : dedup_(dedup), block_size_(block_size > 0 ? block_size : 1) {}
+
+  /**
+   * Merges `k` sources into a sink.
+   *
+   * @return zero on success or -1 if a source or the sink fails
+   */
+  template <class Source, class Sink>
+  int merge(Source *sources, size_t k, Sink &sink) {
+    if (k == 0) {
+      return 0;
+    }
+    blocks_.resize(k * block_size_);
+    cursors_.assign(k, Cursor());
+    std::vector<Id> heads(k);
+    std::vector<uint8_t> live(k);
+    for (size_t i = 0; i < k; i++) {
+      if (refill(sources[i], i) != 0) {
+        return -1;
+      }
+      live[i] = cursors_[i].pos < cursors_[i].end;
+      heads[i] = live[i] ? *cursors_[i].pos : Id{0, 0};
+    }
+    tree_.build(heads.data(), live.data(), k);
+
+    out_.resize(block_size_);
+    has_last_ = false;
+    size_t n_out = 0;
+    while (!tree_.empty()) {
+      size_t w = tree_.winner();
+      Id id = tree_.top();
+      if (!dedup_ || !has_last_ || id != last_) {
+        out_[n_out++] = id;
+        if (n_out == block_size_) {
+          if (sink.write(out_.data(), n_out) != 0) {
+            return -1;
+          }
+          n_out = 0;
+        }
+        last_ = id;
+        has_last_ = true;
+      } else {
+        duplicate_count_++;
+      }
+
+      Cursor &cursor = cursors_[w];
+      if (++cursor.pos == cursor.end && refill(sources[w], w) != 0) {
+        return -1;
+      }
+      if (cursor.pos < cursor.end) {
+        unordered_count_ += *cursor.pos < id;
+        tree_.replace_top(*cursor.pos);
+      } else {
+        tree_.pop_top();
+      }
+    }
+    return n_out > 0 ? sink.write(out_.data(), n_out) : 0;
+  }
+
+  /** Returns the number of IDs read. */
+  uint64_t ids() const { return ids_; }
+
+  /** Returns the number of duplicates dropped. */
+  uint64_t duplicate_count() const { return duplicate_count_; }
+
+  /** Returns the number of IDs less than their predecessor in an input. */
+  uint64_t unordered_count() const { return unordered_count_; }
+
+ private:
+  struct Cursor {
+    const Id *pos = nullptr;
+    const Id *end = nullptr;
+  };
+
+  template <class Source> int refill(Source &source, size_t i) {
+    Id *block = &blocks_[block_size_ * i];
+    ssize_t n = source.read(block, block_size_);
+    if (n < 0) {
+      return -1;
+    }
+    cursors_[i].pos = block;
+    cursors_[i].end = block + n;
+    ids_ += (size_t)n;
+    return 0;
+  }
+
+  bool dedup_;
+  size_t block_size_;
+  LoserTree tree_;
+  std::vector<Id> blocks_; // one block per input
+  std::vector<Cursor> cursors_;
+  std::vector<Id> out_;
+  Id last_ = {0, 0};
+  bool has_last_ = false;
+  uint64_t ids_ = 0;
+  uint64_t duplicate_count_ = 0;
+  uint64_t unordered_count_ = 0;
+};
+
+/**
+ * Merges `k` sorted arrays of IDs in memory on multiple threads.
+ *
+ * The output is split into one part per thread at timestamp boundaries,
+ * found by bisecting the timestamp until the IDs below it in all arrays
+ * (counted by binary search) make up the share of the part. Each thread then
+ * merges its slice of every array with a `LoserTree` straight into its place
+ * in the output. As equal IDs share their timestamp, duplicates never span
+ * two parts, and with `dedup` each part drops them on its own before the
+ * parts are moved together.
+ *
+ * @param runs `k` pointers to sorted arrays
+ * @param sizes `k` lengths of the arrays
+ * @param k number of arrays
+ * @param out receives the merged IDs; must hold the sum of `sizes`
+ * @param dedup true to drop duplicate IDs
+ * @param n_threads number of threads, or zero for the number of cores
+ * @return number of IDs written to `out`
+ */
+inline size_t merge_arrays(const Id *const *runs, const size_t *sizes,
+                           size_t k, Id *out, bool dedup = false,
+                           unsigned n_threads = 0) {
+  if (n_threads == 0) {
+    n_threads = std::thread::hardware_concurrency();
+  }
+  size_t total = 0;
+  uint64_t t_min = UINT64_MAX, t_max = 0;
+  for (size_t i = 0; i < k; i++) {
+    total += sizes[i];
+    if (sizes[i] > 0) {
+      t_min = std::min(t_min, runs[i][0].timestamp());
+      t_max = std::max(t_max, runs[i][sizes[i] - 1].timestamp());
+    }
+  }
+  if (total == 0) {
+    return 0;
+  }
+  size_t n_parts = n_threads > 1 && total >= (size_t)1 << 16 ? n_threads : 1;
+
+  // `bounds[p * k + i]` is where part `p` starts in array `i`
+  std::vector<size_t> bounds((n_parts + 1) * k);
+  for (size_t i = 0; i < k; i++) {
+    bounds[n_parts * k + i] = sizes[i];
+  }
+  auto count_below = [&](uint64_t t, size_t *starts) {
+    Id bound = Id::from_fields(t, 0, 0, 0);
+    size_t count = 0;
+    for (size_t i = 0; i < k; i++) {
+      size_t start = (size_t)(std::lower_bound(runs[i], runs[i] + sizes[i],
+                                               bound) -
+                              runs[i]);
+      if (starts != nullptr) {
+        starts[i] = start;
+      }
+      count += start;
+    }
+    return count;
+  };
+  for (size_t p = 1; p < n_parts; p++) {
+    // find the least timestamp below which at least the share lies
+    size_t share = total / n_parts * p;
+    uint64_t lo = t_min, hi = t_max + 1;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (count_below(mid, nullptr) >= share) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    if (lo > t_max) {
+      memcpy(&bounds[p * k], &bounds[n_parts * k], k * sizeof(size_t));
+    } else {
+      count_below(lo, &bounds[p * k]);
+    }
+  }
+
+  std::vector<size_t> offsets(n_parts + 1), written(n_parts);
+  for (size_t p = 0; p < n_parts; p++) {
+    offsets[p + 1] = offsets[p];
+    for (size_t i = 0; i < k; i++) {
+      offsets[p + 1] += bounds[(p + 1) * k + i] - bounds[p * k + i];
+    }
+  }
+  auto merge_part = [&](size_t p) {
+    const size_t *begins = &bounds[p * k], *ends = &bounds[(p + 1) * k];
+    std::vector<size_t> pos(begins, begins + k);
+    std::vector<Id> heads(k);
+    std::vector<uint8_t> live(k);
+    for (size_t i = 0; i < k; i++) {
+      live[i] = pos[i] < ends[i];
+      heads[i] = live[i] ? runs[i][pos[i]] : Id{0, 0};
+    }
+    LoserTree tree;
+    tree.build(heads.data(), live.data(), k);
+    Id *dst = out + offsets[p];
+    size_t n = 0;
+    while (!tree.empty()) {
+      size_t w = tree.winner();
+      const Id &id = tree.top();
+      if (!dedup || n == 0 || id != dst[n - 1]) {
+        dst[n++] = id;
+      }
+      if (++pos[w] < ends[w]) {
+        tree.replace_top(runs[w][pos[w]]);
+      } else {
+        tree.pop_top();
+      }
+    }
+    written[p] = n;
+  };
+  std::vector<std::thread> threads;
+  for (size_t p = 1; p < n_parts; p++) {
+    threads.emplace_back(merge_part, p);
+  }
+  merge_part(0);
+  for (auto &th : threads) {
+    th.join();
+  }
+
+  size_t n = written[0];
+  for (size_t p = 1; p < n_parts; p++) {
+    memmove(out + n, out + offsets[p], written[p] * sizeof(Id));
+    n += written[p];
+  }
+  return n;
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_MERGE_HPP */
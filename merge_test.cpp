@@ -0,0 +1,311 @@
+/** merge_test.cpp - Tests for merge.hpp */
+
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "id.hpp"
+#include "merge.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+/**
+ * Generates one sorted stream of `n` IDs per each of `n_gens` generators, one
+ * millisecond every `ids_per_ms` IDs.
+ */
+static std::vector<std::vector<Id>> generate_streams(int n_gens, size_t n,
+                                                     uint64_t ids_per_ms) {
+  std::vector<std::vector<Id>> streams(n_gens);
+  for (int k = 0; k < n_gens; k++) {
+    streams[k] = generate_ids(n, ids_per_ms, k);
+  }
+  return streams;
+}
+
+/** Returns the sorted concatenation of streams, without duplicates if asked. */
+static std::vector<Id> expected_merge(
+    const std::vector<std::vector<Id>> &streams, bool dedup) {
+  std::vector<Id> all;
+  for (const std::vector<Id> &s : streams) {
+    all.insert(all.end(), s.begin(), s.end());
+  }
+  std::sort(all.begin(), all.end());
+  if (dedup) {
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+  }
+  return all;
+}
+
+/** Merges streams with `StreamMerger` and with `merge_arrays()`. */
+static void check_merge(const std::vector<std::vector<Id>> &streams,
+                        bool dedup) {
+  std::vector<Id> expected = expected_merge(streams, dedup);
+  size_t total = 0;
+  std::vector<ArraySource> sources;
+  std::vector<const Id *> runs;
+  std::vector<size_t> sizes;
+  for (const std::vector<Id> &s : streams) {
+    total += s.size();
+    sources.emplace_back(s.data(), s.size());
+    runs.push_back(s.data());
+    sizes.push_back(s.size());
+  }
+
+  for (size_t block_size : {1, 7, 1024}) {
+    std::vector<ArraySource> copies(sources);
+    StreamMerger merger(dedup, block_size);
+    VectorSink sink;
+    assert(merger.merge(copies.data(), copies.size(), sink) == 0);
+    assert(sink.ids == expected);
+    assert(merger.ids() == total);
+    assert(merger.duplicate_count() == total - expected.size() || !dedup);
+    assert(merger.unordered_count() == 0);
+  }
+
+  for (unsigned t : {1, 2, 5}) {
+    std::vector<Id> out(total);
+    size_t n = merge_arrays(runs.data(), sizes.data(), runs.size(),
+                            out.data(), dedup, t);
+    out.resize(n);
+    assert(out == expected);
+  }
+}
+
+/** Merges many, few, empty, and overlapping streams. */
+static void test_merge(void) {
+  check_merge({}, false);
+  check_merge({{}, {}}, true);
+  for (bool dedup : {false, true}) {
+    check_merge(generate_streams(1, 1000, 10), dedup);
+    check_merge(generate_streams(3, 30000, 100), dedup);
+    check_merge(generate_streams(1000, 100, 1), dedup);
+
+    // empty streams among ones that interleave within every millisecond
+    std::vector<std::vector<Id>> streams = generate_streams(37, 3000, 1000);
+    streams[0].clear();
+    streams[20].clear();
+    streams.emplace_back();
+    check_merge(streams, dedup);
+  }
+}
+
+/** Drops duplicates within and across streams and counts disorder. */
+static void test_dedup(void) {
+  std::vector<std::vector<Id>> streams = generate_streams(8, 20000, 50);
+  // resend part of a stream from another node and repeat IDs in place
+  streams[7].insert(streams[7].end(), streams[3].begin() + 100,
+                    streams[3].begin() + 5000);
+  std::sort(streams[7].begin(), streams[7].end());
+  for (size_t i = 0; i < 200; i++) {
+    streams[5].insert(streams[5].begin() + 101 * i, streams[5][101 * i]);
+  }
+  check_merge(streams, true);
+  check_merge(streams, false);
+
+  std::vector<ArraySource> sources;
+  for (const std::vector<Id> &s : streams) {
+    sources.emplace_back(s.data(), s.size());
+  }
+  StreamMerger merger(true, 256);
+  VectorSink sink;
+  assert(merger.merge(sources.data(), sources.size(), sink) == 0);
+  assert(merger.duplicate_count() == 4900 + 200);
+
+  // an ID below its predecessor is passed through and counted
+  std::vector<Id> unordered = {Id{1, 0}, Id{3, 0}, Id{2, 0}, Id{4, 0}};
+  std::vector<Id> other = {Id{0, 5}};
+  ArraySource pair[] = {ArraySource(unordered.data(), 4),
+                        ArraySource(other.data(), 1)};
+  StreamMerger merger2(false, 2);
+  VectorSink sink2;
+  assert(merger2.merge(pair, 2, sink2) == 0);
+  assert(merger2.unordered_count() == 1 && sink2.ids.size() == 5);
+}
+
+/** Returns the contents of a file descriptor from the start. */
+static std::string read_file(int fd) {
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  std::string data;
+  char buf[4096];
+  for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) {
+    data.append(buf, (size_t)n);
+  }
+  return data;
+}
+
+/** Reads and writes text and binary files. */
+static void test_files(void) {
+  std::vector<std::vector<Id>> streams = generate_streams(3, 5000, 10);
+  std::vector<Id> expected = expected_merge(streams, false);
+
+  // mixed case, CRLF, blank and invalid lines, and no line break at the end
+  std::string texts[3];
+  for (int k = 0; k < 3; k++) {
+    for (size_t i = 0; i < streams[k].size(); i++) {
+      char text[26];
+      streams[k][i].encode(text);
+      if (k == 1) {
+        for (char &c : text) {
+          c = c >= 'a' && c <= 'z' ? (char)(c - 32) : c;
+        }
+      }
+      texts[k] += text;
+      texts[k] += k == 2 ? "\r\n" : "\n";
+      if (i % 1000 == 999) {
+        texts[k] += k == 0 ? "\n" : "not an id\n";
+      }
+    }
+    texts[k].pop_back();
+  }
+  FdSource text_sources[] = {FdSource(temp_file(texts[0]), false, 100),
+                             FdSource(temp_file(texts[1]), false, 4096),
+                             FdSource(temp_file(texts[2]), false)};
+  int out_fd = temp_file("");
+  FdSink text_sink(out_fd, false);
+  StreamMerger merger(false, 100);
+  assert(merger.merge(text_sources, 3, text_sink) == 0);
+  assert(merger.ids() == expected.size());
+  assert(text_sources[0].invalid() == 4 && text_sources[1].invalid() == 5);
+
+  std::string merged = read_file(out_fd);
+  assert(merged.size() == 26 * expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    char text[26];
+    expected[i].encode(text);
+    assert(memcmp(&merged[26 * i], text, 25) == 0);
+    assert(merged[26 * i + 25] == '\n');
+  }
+
+  // binary in and out, with a partial record at the end of one file
+  std::string binaries[3];
+  for (int k = 0; k < 3; k++) {
+    for (const Id &id : streams[k]) {
+      uint8_t bytes[16];
+      id.to_bytes(bytes);
+      binaries[k].append((const char *)bytes, 16);
+    }
+  }
+  binaries[1].append("partial");
+  FdSource binary_sources[] = {FdSource(temp_file(binaries[0]), true, 16),
+                               FdSource(temp_file(binaries[1]), true, 1000),
+                               FdSource(temp_file(binaries[2]), true)};
+  int binary_fd = temp_file("");
+  FdSink binary_sink(binary_fd, true);
+  assert(StreamMerger().merge(binary_sources, 3, binary_sink) == 0);
+  assert(binary_sources[1].invalid() == 1);
+  std::string binary = read_file(binary_fd);
+  assert(binary.size() == 16 * expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    assert(Id::from_bytes((const uint8_t *)&binary[16 * i]) == expected[i]);
+  }
+
+  FdSource closed(-1, false);
+  VectorSink sink;
+  assert(StreamMerger().merge(&closed, 1, sink) == -1);
+}
+
+/** Skips lines longer than the buffer without growing it. */
+static void test_overlong_lines(void) {
+  std::vector<Id> ids = generate_ids(3, 1);
+  char text[3][26];
+  for (int i = 0; i < 3; i++) {
+    ids[i].encode(text[i]);
+    text[i][25] = '\n';
+  }
+  std::string data(text[0], 26);
+  data += std::string(100000, '0') + "\n"; // valid digits, but far too many
+  data.append(text[1], 26);
+  data += std::string(64, 'x') + "\n";
+  data.append(text[2], 26);
+  data += std::string(1000, 'z'); // at the end without a line break
+
+  for (size_t buffer_size : {32, 64, 65, 4096}) {
+    int fd = temp_file(data);
+    FdSource source(fd, false, buffer_size);
+    std::vector<Id> read_ids;
+    Id id;
+    while (source.read(&id, 1) > 0) {
+      read_ids.push_back(id);
+      if (read_ids.size() == 2) {
+        // nothing beyond one buffer after the second ID has been read ahead
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        assert(offset <= (off_t)(26 + 100001 + 26 + buffer_size));
+      }
+    }
+    assert(read_ids == ids);
+    assert(source.invalid() == 3);
+    close(fd);
+  }
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Merges 10 million IDs from 10-10000 streams with `StreamMerger` and with
+ * `merge_arrays()` on 1-8 threads, and compares them with copying the
+ * streams, the sequential-read bound.
+ */
+static void run_benchmarks(void) {
+  const size_t N = 10000000;
+  for (int k : {10, 1000, 10000}) {
+    std::vector<std::vector<Id>> streams = generate_streams(k, N / k, 10);
+    std::vector<ArraySource> sources;
+    std::vector<const Id *> runs;
+    std::vector<size_t> sizes;
+    for (const std::vector<Id> &s : streams) {
+      sources.emplace_back(s.data(), s.size());
+      runs.push_back(s.data());
+      sizes.push_back(s.size());
+    }
+    std::vector<Id> out(N);
+
+    uint64_t start = now_ns();
+    size_t pos = 0;
+    for (const std::vector<Id> &s : streams) {
+      memcpy(&out[pos], s.data(), s.size() * sizeof(Id));
+      pos += s.size();
+    }
+    double copy_ms = (double)(now_ns() - start) / 1e6;
+
+    VectorSink sink;
+    sink.ids.reserve(N);
+    StreamMerger merger(true);
+    start = now_ns();
+    merger.merge(sources.data(), sources.size(), sink);
+    double stream_ms = (double)(now_ns() - start) / 1e6;
+
+    printf("%5d streams  copy: %6.1f ms  StreamMerger: %7.1f ms  "
+           "merge_arrays:",
+           k, copy_ms, stream_ms);
+    for (unsigned t = 1; t <= 8; t *= 2) {
+      start = now_ns();
+      merge_arrays(runs.data(), sizes.data(), k, out.data(), true, t);
+      printf("  %u: %6.1f ms", t, (double)(now_ns() - start) / 1e6);
+    }
+    printf("\n");
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_merge();
+  test_dedup();
+  test_files();
+  test_overlong_lines();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
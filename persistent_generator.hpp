@@ -0,0 +1,212 @@
+/** persistent_generator.hpp - Generator monotonic across process restarts */
+
+#ifndef SCRU128_PERSISTENT_GENERATOR_HPP
+#define SCRU128_PERSISTENT_GENERATOR_HPP
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clock.hpp"
+#include "generator.hpp"
+#include "random.hpp"
+
+namespace scru128 {
+
+/** Value of `HighWaterMark::Record::magic` of a valid file. */
+constexpr uint64_t HIGH_WATER_MARK_MAGIC = 0x7363727531323802;
+
+/**
+ * Keeps a persistent upper bound of the `timestamp` values generated so far in
+ * a memory-mapped file.
+ *
+ * Rather than persisting every new `timestamp`, the mark is moved to the
+ * `timestamp` plus a lease of `lease_ms` milliseconds whenever a `timestamp`
+ * reaches it, so the file is synced at most about once per lease while the
+ * check on the hot path is a single comparison against a cached value. All
+ * `timestamp` values generated before a crash or restart are less than the
+ * persisted mark, which is therefore a safe starting point for the next run.
+ *
+ * The mark is an aligned 64-bit word within a single page, so a crash during
+ * `msync()` leaves either the old or the new value.
+ */
+class HighWaterMark {
+ public:
+  struct Record {
+    uint64_t magic;
+    uint64_t mark;
+  };
+
+  HighWaterMark() = default;
+  HighWaterMark(const HighWaterMark &) = delete;
+  HighWaterMark &operator=(const HighWaterMark &) = delete;
+  ~HighWaterMark() { close(); }
+
+  /**
+   * Opens or creates the mark file.
+   *
+   * @param path path to the mark file
+   * @param lease_ms distance in milliseconds by which the mark is moved ahead,
+   * which must be at least one to keep every `timestamp` below the mark
+   * @return zero on success or non-zero on failure
+   */
+  int open(const char *path, uint64_t lease_ms = 1000) {
+    close();
+    if (lease_ms == 0) {
+      return -1;
+    }
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (st.st_size == 0 && ftruncate(fd, sizeof(Record)) != 0) ||
+        (st.st_size != 0 && st.st_size != (off_t)sizeof(Record))) {
+      ::close(fd);
+      return -1;
+    }
+    void *addr = mmap(nullptr, sizeof(Record), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      return -1;
+    }
+
+    Record *record = (Record *)addr;
+    if (record->magic == 0 && record->mark == 0) {
+      record->magic = HIGH_WATER_MARK_MAGIC;
+    } else if (record->magic != HIGH_WATER_MARK_MAGIC) {
+      munmap(addr, sizeof(Record));
+      return -1;
+    }
+    record_ = record;
+    mark_ = record->mark;
+    lease_ms_ = lease_ms;
+    return 0;
+  }
+
+  /** Unmaps the mark file. */
+  void close() {
+    if (record_ != nullptr) {
+      munmap(record_, sizeof(Record));
+      record_ = nullptr;
+    }
+  }
+
+  /** Returns the persisted mark (zero for a new file). */
+  uint64_t mark() const { return mark_; }
+
+  /**
+   * Ensures that `timestamp` is less than the persisted mark, moving the mark
+   * ahead and syncing the file if it is not.
+   *
+   * @return zero on success or non-zero if the file could not be synced
+   */
+  int cover(uint64_t timestamp) {
+    if (timestamp < mark_) {
+      return 0;
+    }
+    uint64_t mark = timestamp + lease_ms_;
+    __atomic_store_n(&record_->mark, mark, __ATOMIC_RELAXED);
+    if (msync(record_, sizeof(Record), MS_SYNC) != 0) {
+      return -1;
+    }
+    mark_ = mark;
+    syncs_++;
+    return 0;
+  }
+
+  /** Returns the number of times the file has been synced. */
+  uint64_t syncs() const { return syncs_; }
+
+ private:
+  Record *record_ = nullptr;
+  uint64_t mark_ = 0;
+  uint64_t lease_ms_ = 0;
+  uint64_t syncs_ = 0;
+};
+
+/**
+ * Generates IDs that stay in monotonic order across restarts of the process.
+ *
+ * On `open()`, the generator resumes from the persisted high-water mark, which
+ * is greater than any `timestamp` generated by the previous run; hence, IDs
+ * generated after a restart sort after those generated before, even if the
+ * clock has been set back, as long as the clock is behind the mark by no more
+ * than the rollback allowance. A larger gap is a large clock rollback and is
+ * handled as such by the underlying `Generator`; use
+ * `RollbackAction::ABORT` to refuse to generate IDs out of order.
+ *
+ * An ID is returned to the caller only after its `timestamp` has been covered
+ * by the persisted mark. With a lease of `lease_ms` milliseconds, the file is
+ * synced about `1000 / lease_ms` times per second under continuous load, and
+ * a restart moves `timestamp` ahead of the wall clock by up to `lease_ms`,
+ * which the generator absorbs as a small clock rollback.
+ */
+template <class Clock = RealtimeClock, class Random = SystemRandom>
+class PersistentGenerator {
+ public:
+  explicit PersistentGenerator(Clock clock = Clock(), Random random = Random(),
+                               GeneratorPolicy policy = GeneratorPolicy())
+      : generator_(clock, random, policy) {}
+
+  /**
+   * Opens the mark file and resumes from the persisted mark.
+   *
+   * @param lease_ms lease of the mark in milliseconds (at least one)
+   * @return zero on success or non-zero on failure
+   */
+  int open(const char *path, uint64_t lease_ms = 1000) {
+    if (mark_.open(path, lease_ms) != 0) {
+      return -1;
+    }
+    if (mark_.mark() > 0) {
+      generator_.resume_from(mark_.mark());
+    }
+    return 0;
+  }
+
+  /**
+   * Generates a new ID.
+   *
+   * @param out 16-byte byte array
+   * @return zero on success or non-zero if the mark could not be persisted
+   * or if the underlying generator fails
+   */
+  int generate(uint8_t *out) {
+    if (generator_.generate(out) != 0) {
+      return -1;
+    }
+    return mark_.cover(generator_.timestamp());
+  }
+
+  /**
+   * Generates `n` new IDs at once (see `Generator::generate_many()`).
+   *
+   * @return zero on success or non-zero if the mark could not be persisted
+   */
+  int generate_many(size_t n, uint8_t *out, char *text_out = nullptr) {
+    if (generator_.generate_many(n, out, text_out) != 0) {
+      return -1;
+    }
+    return mark_.cover(generator_.timestamp());
+  }
+
+  /** Returns the high-water mark. */
+  const HighWaterMark &high_water_mark() const { return mark_; }
+
+  /** Returns the underlying generator. */
+  Generator<Clock, Random> &generator() { return generator_; }
+
+ private:
+  Generator<Clock, Random> generator_;
+  HighWaterMark mark_;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_PERSISTENT_GENERATOR_HPP */
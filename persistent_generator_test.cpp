@@ -0,0 +1,158 @@
+/** persistent_generator_test.cpp - Tests for persistent_generator.hpp */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "persistent_generator.hpp"
+#include "test_fixtures.hpp"
+
+using namespace scru128;
+
+static uint64_t timestamp_of(const uint8_t *id) {
+  uint64_t ts = 0;
+  for (int i = 0; i < 6; i++) {
+    ts = ts << 8 | id[i];
+  }
+  return ts;
+}
+
+static void make_temp_path(char *path) {
+  strcpy(path, "/tmp/scru128-hwm-XXXXXX");
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  unlink(path);
+}
+
+/** Syncs once per lease and keeps every timestamp below the mark. */
+static void test_lease(void) {
+  char path[64];
+  make_temp_path(path);
+
+  PersistentGenerator<FixedClock> g;
+  assert(g.open(path, 100) == 0);
+  assert(g.high_water_mark().mark() == 0);
+
+  uint64_t ts = T;
+  uint8_t id[16];
+  for (uint64_t i = 0; i < 1000; i++) {
+    g.generator().clock().now = ts + i;
+    assert(g.generate(id) == 0);
+    assert(timestamp_of(id) < g.high_water_mark().mark());
+  }
+  assert(g.high_water_mark().syncs() == 10);
+  assert(g.high_water_mark().mark() == ts + 1000);
+
+  unlink(path);
+}
+
+/** Resumes above the mark after a restart with the clock set back. */
+static void test_restart(void) {
+  char path[64];
+  make_temp_path(path);
+  uint64_t ts = T;
+  uint8_t prev[16], curr[16];
+
+  {
+    PersistentGenerator<FixedClock> g;
+    assert(g.open(path, 1000) == 0);
+    g.generator().clock().now = ts;
+    for (int i = 0; i < 100; i++) {
+      assert(g.generate(prev) == 0);
+    }
+  }
+  {
+    PersistentGenerator<FixedClock> g;
+    assert(g.open(path, 1000) == 0);
+    assert(g.high_water_mark().mark() == ts + 1000);
+    g.generator().clock().now = ts - 5000;
+    assert(g.generate(curr) == 0);
+    assert(memcmp(prev, curr, 16) < 0);
+    assert(timestamp_of(curr) == ts + 1000);
+    assert(g.high_water_mark().mark() == ts + 2000);
+  }
+
+  unlink(path);
+}
+
+/** Rejects a file that holds something other than a mark. */
+static void test_foreign_file(void) {
+  char path[64];
+  make_temp_path(path);
+  FILE *fp = fopen(path, "w");
+  fputs("not a high-water mark", fp);
+  fclose(fp);
+
+  HighWaterMark mark;
+  assert(mark.open(path) != 0);
+  unlink(path);
+}
+
+/** Rejects a zero lease, which would not keep timestamps below the mark. */
+static void test_zero_lease(void) {
+  char path[64];
+  make_temp_path(path);
+  PersistentGenerator<FixedClock> g;
+  assert(g.open(path, 0) != 0);
+  assert(access(path, F_OK) != 0);
+  assert(g.open(path, 1) == 0);
+
+  g.generator().clock().now = T;
+  uint8_t id[16];
+  for (int i = 0; i < 3; i++) {
+    assert(g.generate(id) == 0);
+    assert(timestamp_of(id) < g.high_water_mark().mark());
+  }
+  unlink(path);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Reports generation cost and syncs per second for several leases. */
+static void bench_leases(void) {
+  const uint64_t LEASES[] = {10, 100, 1000};
+  for (uint64_t lease_ms : LEASES) {
+    char path[64];
+    make_temp_path(path);
+    PersistentGenerator<> g;
+    assert(g.open(path, lease_ms) == 0);
+
+    uint8_t id[16];
+    uint64_t n = 0;
+    uint64_t start = now_ns();
+    uint64_t elapsed;
+    do {
+      for (int i = 0; i < 10000; i++) {
+        g.generate(id);
+      }
+      n += 10000;
+      elapsed = now_ns() - start;
+    } while (elapsed < 2000000000);
+
+    printf("lease %4llu ms: %6.2f ns/id  %7.2f syncs/s\n",
+           (unsigned long long)lease_ms, (double)elapsed / n,
+           g.high_water_mark().syncs() * 1e9 / elapsed);
+    unlink(path);
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_lease();
+  test_restart();
+  test_foreign_file();
+  test_zero_lease();
+#ifdef RUN_BENCHMARKS
+  bench_leases();
+#endif
+  return 0;
+}
@@ -0,0 +1,42 @@
+/** probes.h - USDT static tracepoints for codec and generator rare paths */
+
+#ifndef SCRU128_PROBES_H
+#define SCRU128_PROBES_H
+
+/*
+ * When compiled with `USE_SDT_PROBES`, the `SCRU128_PROBE*` macros expand to
+ * Linux SDT (USDT) probes of provider `scru128`, each of which is a single
+ * `nop` instruction plus an ELF note until a tracer attaches to it; otherwise
+ * they expand to nothing. The probes sit on rare paths only (decoding errors,
+ * counter overflows, clock rollbacks, and entropy pool refills), e.g.:
+ *
+ *     bpftrace -e 'usdt:./app:scru128:counter_overflow { @ = count(); }'
+ *
+ * Probes and their arguments:
+ *
+ * | Probe                   | Arguments                       |
+ * | ----------------------- | ------------------------------- |
+ * | `decode_invalid_digit`  | position of invalid character   |
+ * | `decode_invalid_length` | (none)                          |
+ * | `decode_out_of_range`   | (none)                          |
+ * | `counter_overflow`      | new `timestamp`                 |
+ * | `clock_rollback`        | last `timestamp`, clock reading |
+ * | `clock_reset`           | last `timestamp`, clock reading |
+ * | `clock_abort`           | last `timestamp`, clock reading |
+ * | `cas_retry`             | (none)                          |
+ * | `entropy_refill_start`  | number of bytes requested       |
+ * | `entropy_refill_done`   | number of bytes requested       |
+ */
+
+#ifdef USE_SDT_PROBES
+#include <sys/sdt.h>
+#define SCRU128_PROBE0(name) DTRACE_PROBE(scru128, name)
+#define SCRU128_PROBE1(name, a) DTRACE_PROBE1(scru128, name, a)
+#define SCRU128_PROBE2(name, a, b) DTRACE_PROBE2(scru128, name, a, b)
+#else
+#define SCRU128_PROBE0(name) ((void)0)
+#define SCRU128_PROBE1(name, a) ((void)0)
+#define SCRU128_PROBE2(name, a, b) ((void)0)
+#endif /* #ifdef USE_SDT_PROBES */
+
+#endif /* #ifndef SCRU128_PROBES_H */
@@ -0,0 +1,103 @@
+/** probes_test.cpp - Exercises the paths instrumented by probes.h
+ *
+ * Build this file with and without `-DUSE_SDT_PROBES` (and `-DRUN_BENCHMARKS`)
+ * to compare the cost of the disabled probes. The probes can be listed with
+ * `readelf -n` or `bpftrace -l 'usdt:./probes_test:*'`.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "generator.hpp"
+#include "test_fixtures.hpp"
+
+#define BASE36_128_NO_MAIN
+extern "C" {
+#include "base36_128.c"
+}
+
+using namespace scru128;
+
+/** Fails to decode invalid strings on each instrumented path. */
+static void test_decode_errors(void) {
+  uint8_t out[16];
+  assert(::decode("0372hg16csmsm50l8dikcvuk+", out) != 0);
+  assert(::decode("0372hg16csmsm50l8dikcvukc0", out) != 0);
+  assert(::decode("zzzzzzzzzzzzzzzzzzzzzzzzz", out) != 0);
+  assert(::decode("0372hg16csmsm50l8dikcvukc", out) == 0);
+
+  assert(scru128::decode("0372hg16csmsm50l8dikcvuk+", out) != 0);
+  assert(scru128::decode("0372hg16csmsm50l8dikcvukc0", out) != 0);
+  assert(scru128::decode("zzzzzzzzzzzzzzzzzzzzzzzzz", out) != 0);
+  assert(scru128::decode("0372hg16csmsm50l8dikcvukc", out) == 0);
+}
+
+/** Overflows counters, rolls back the clock, and refills the pool. */
+static void test_generator_paths(void) {
+  Generator<FixedClock, MaxRandom> g;
+  uint64_t ts = T;
+  uint8_t ids[64 * 16];
+
+  g.clock().now = ts;
+  for (int i = 0; i < 100; i++) {
+    g.generate(ids);
+  }
+  assert(g.stats().counter_overflows > 0);
+  g.clock().now = ts - 1;
+  g.generate(ids);
+  assert(g.stats().tolerated_rollbacks > 0);
+  g.clock().now = ts - DEFAULT_ROLLBACK_ALLOWANCE - 1000;
+  g.generate(ids);
+  assert(g.stats().resets == 1);
+  g.generate_many(64, ids);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void run_benchmarks(void) {
+  const int N = 10000000;
+  uint8_t out[16];
+  int sink = 0;
+
+  uint64_t start = now_ns();
+  for (int i = 0; i < N; i++) {
+    sink += ::decode("zzzzzzzzzzzzzzzzzzzzzzzzz", out);
+  }
+  double decode_ns = (double)(now_ns() - start) / N;
+
+  // every other ID overflows counters with all-one random numbers
+  Generator<FixedClock, MaxRandom> g;
+  g.clock().now = T;
+  start = now_ns();
+  for (int i = 0; i < N; i++) {
+    sink += g.generate(out);
+  }
+  double overflow_ns = (double)(now_ns() - start) / N;
+
+#ifdef USE_SDT_PROBES
+  const char *build = "with probes";
+#else
+  const char *build = "without probes";
+#endif
+  printf("%s: decode out of range: %6.2f ns/call  "
+         "generate with overflow: %6.2f ns/id  (%d)\n",
+         build, decode_ns, overflow_ns, sink & 1);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_decode_errors();
+  test_generator_paths();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,156 @@
+/** random.hpp - Random number sources for SCRU128 generators */
+
+#ifndef SCRU128_RANDOM_HPP
+#define SCRU128_RANDOM_HPP
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+#include "probes.h"
+
+namespace scru128 {
+
+/**
+ * Draws cryptographically strong random bytes from the operating system.
+ *
+ * Every random source used with a generator exposes
+ * `int fill(void *buf, size_t len)`, which fills `buf` with `len` random bytes
+ * and returns zero on success or non-zero on failure.
+ */
+struct SystemRandom {
+  int fill(void *buf, size_t len) {
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0) {
+      ssize_t n = getrandom(p, len, 0);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      p += n;
+      len -= (size_t)n;
+    }
+    return 0;
+  }
+};
+
+/**
+ * Draws NON-CRYPTOGRAPHIC pseudorandom bytes from the wyrand generator.
+ *
+ * The output is fully determined by the seed, which makes this source useful
+ * for reproducible tests and load generation, but it is predictable and must
+ * never be used to generate IDs that leave a test environment. The byte
+ * stream is the same on all platforms for the same seed.
+ */
+class WyrandRandom {
+ public:
+  explicit WyrandRandom(uint64_t seed) : state_(seed) {}
+
+  uint64_t next_u64() {
+    state_ += 0xa0761d6478bd642f;
+    unsigned __int128 t =
+        (unsigned __int128)state_ * (state_ ^ 0xe7037ed1a0b428db);
+    return (uint64_t)(t >> 64) ^ (uint64_t)t;
+  }
+
+  int fill(void *buf, size_t len) {
+    uint8_t *p = (uint8_t *)buf;
+    for (; len >= 8; p += 8, len -= 8) {
+      uint64_t word = next_u64();
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      word = __builtin_bswap64(word);
+#endif
+      memcpy(p, &word, 8);
+    }
+    if (len > 0) {
+      uint64_t word = next_u64();
+      for (size_t i = 0; i < len; i++) {
+        p[i] = (uint8_t)(word >> (8 * i));
+      }
+    }
+    return 0;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+/**
+ * Buffers random bytes drawn from a random source.
+ *
+ * A generator consumes 4 to 10 random bytes per ID, and a system call per ID
+ * would dominate its cost. The pool refills its buffer in one call to the
+ * underlying source and serves small requests from it.
+ *
+ * A failure of the underlying source is considered fatal because the quality
+ * of random numbers is essential to the uniqueness of IDs; the pool aborts
+ * the process rather than returning predictable values.
+ */
+template <class Random = SystemRandom> class EntropyPool {
+ public:
+  static constexpr size_t CAPACITY = 256;
+
+  explicit EntropyPool(Random random = Random()) : random_(random) {}
+
+  /** Returns a 32-bit random number. */
+  uint32_t next_u32() {
+    if (pos_ + 4 > CAPACITY) {
+      refill();
+    }
+    uint32_t value;
+    memcpy(&value, buf_ + pos_, 4);
+    pos_ += 4;
+    return value;
+  }
+
+  /** Returns a 24-bit random number. */
+  uint32_t next_u24() { return next_u32() >> 8; }
+
+  /**
+   * Fills `buf` with `len` random bytes. Requests larger than the buffer go
+   * directly to the underlying source in a single call.
+   */
+  void fill(void *buf, size_t len) {
+    if (len > CAPACITY / 2) {
+      SCRU128_PROBE1(entropy_refill_start, len);
+      if (random_.fill(buf, len) != 0) {
+        abort_on_failure();
+      }
+      SCRU128_PROBE1(entropy_refill_done, len);
+      return;
+    }
+    if (pos_ + len > CAPACITY) {
+      refill();
+    }
+    memcpy(buf, buf_ + pos_, len);
+    pos_ += len;
+  }
+
+  /** Returns the underlying random source. */
+  Random &source() { return random_; }
+
+ private:
+  void refill() {
+    SCRU128_PROBE1(entropy_refill_start, CAPACITY);
+    if (random_.fill(buf_, CAPACITY) != 0) {
+      abort_on_failure();
+    }
+    SCRU128_PROBE1(entropy_refill_done, CAPACITY);
+    pos_ = 0;
+  }
+
+  [[noreturn]] static void abort_on_failure() { abort(); }
+
+  Random random_;
+  size_t pos_ = CAPACITY;
+  uint8_t buf_[CAPACITY];
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_RANDOM_HPP */
@@ -0,0 +1,542 @@
+/** sort.hpp - Parallel radix sorts for large arrays of IDs */
+
+#ifndef SCRU128_SORT_HPP
+#define SCRU128_SORT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "codec.hpp"
+#include "id.hpp"
+
+namespace scru128 {
+
+/** Thread management shared by the sorters. */
+class ParallelSorter {
+ protected:
+  /**
+   * @param n_threads number of threads, or zero for the number of cores
+   */
+  explicit ParallelSorter(unsigned n_threads) {
+    if (n_threads == 0) {
+      n_threads = std::thread::hardware_concurrency();
+    }
+    n_threads_ = n_threads > 0 ? n_threads : 1;
+  }
+
+  size_t chunk_size(size_t n) const {
+    return (n + n_threads_ - 1) / n_threads_;
+  }
+
+  /** Calls `f(begin, end)` on one chunk of `[0, n)` per thread. */
+  template <class F> void for_each_chunk(size_t n, const F &f) {
+    size_t size = chunk_size(n);
+    std::vector<std::thread> threads;
+    for (size_t begin = size; begin < n; begin += size) {
+      threads.emplace_back(f, begin, std::min(begin + size, n));
+    }
+    f(0, std::min(size, n));
+    for (auto &th : threads) {
+      th.join();
+    }
+  }
+
+  /** Calls `f()` on every thread. */
+  template <class F> void run_threads(const F &f) {
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < n_threads_; t++) {
+      threads.emplace_back(f);
+    }
+    f();
+    for (auto &th : threads) {
+      th.join();
+    }
+  }
+
+  /**
+   * Calls `f(begin, count)` on every non-empty bucket given by `offsets` (the
+   * start of each bucket, followed by the end of the last) on all threads,
+   * largest bucket first for balance.
+   */
+  template <class F>
+  void for_each_bucket(const std::vector<size_t> &offsets, const F &f) {
+    std::vector<size_t> order;
+    for (size_t b = 0; b + 1 < offsets.size(); b++) {
+      if (offsets[b + 1] > offsets[b]) {
+        order.push_back(b);
+      }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return offsets[a + 1] - offsets[a] > offsets[b + 1] - offsets[b];
+    });
+    std::atomic<size_t> next(0);
+    run_threads([&] {
+      for (size_t k; (k = next++) < order.size();) {
+        size_t b = order[k];
+        f(offsets[b], offsets[b + 1] - offsets[b]);
+      }
+    });
+  }
+
+  unsigned n_threads_;
+};
+
+/**
+ * Sorts large arrays of IDs in ascending order with a most-significant-digit
+ * radix sort adapted to the layout of SCRU128.
+ *
+ * As IDs lead with `timestamp`, a real-world array shares many leading bits
+ * (every ID of a day has the same top 21 bits), and a plain byte-wise MSD
+ * sort would waste its first passes on a single bucket. Instead, each pass
+ * finds the minimum and maximum of its range and distributes on the 8 bits
+ * right below their common prefix, so that every pass splits the range
+ * effectively, down to ranges of `SMALL_RANGE` IDs or fewer, which are
+ * finished by insertion sort. Passes alternate between the array and a
+ * scratch buffer of the same size, moving each ID once per pass.
+ *
+ * The first pass is split among threads (per-thread histograms, then a
+ * stable scatter) and the resulting buckets are sorted by the threads in
+ * parallel.
+ *
+ * Before sorting, the array is scanned for ascending runs; nearly sorted
+ * input that consists of at most `MAX_MERGE_RUNS` runs, such as IDs appended
+ * by a few generators or concatenated sorted files, is merged instead.
+ */
+class IdSorter : private ParallelSorter {
+ public:
+  /** Ranges of at most this many IDs are sorted by insertion sort. */
+  static constexpr size_t SMALL_RANGE = 48;
+
+  /** Input of at most this many ascending runs is merged. */
+  static constexpr size_t MAX_MERGE_RUNS = 32;
+
+  /**
+   * @param n_threads number of threads, or zero for the number of cores
+   */
+  explicit IdSorter(unsigned n_threads = 0) : ParallelSorter(n_threads) {}
+
+  /** Sorts `n` IDs in place. */
+  void sort(Id *ids, size_t n) {
+    if (n < 2) {
+      return;
+    }
+    std::vector<size_t> runs = find_runs(ids, n);
+    if (runs.size() == 2) {
+      return; // already sorted
+    }
+    scratch_.resize(n);
+    if (runs.size() <= MAX_MERGE_RUNS + 1) {
+      merge_runs(ids, scratch_.data(), runs);
+    } else {
+      sort_parallel(ids, scratch_.data(), n);
+    }
+  }
+
+  /**
+   * Sorts `n` 16-byte binary IDs in place. The IDs are converted to and from
+   * native words around `sort()`, which takes another `16 * n` bytes.
+   */
+  void sort_binary(uint8_t *ids, size_t n) {
+    std::vector<Id> words(n);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        words[i] = Id::from_bytes(ids + 16 * i);
+      }
+    });
+    sort(words.data(), n);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        words[i].to_bytes(ids + 16 * i);
+      }
+    });
+  }
+
+  /** Releases the scratch buffer kept between calls. */
+  void release() { std::vector<Id>().swap(scratch_); }
+
+ private:
+  typedef unsigned __int128 u128;
+
+  /** Returns the start of each ascending run, followed by `n`. */
+  static std::vector<size_t> find_runs(const Id *ids, size_t n) {
+    std::vector<size_t> runs = {0};
+    for (size_t i = 1; i < n; i++) {
+      if (ids[i] < ids[i - 1]) {
+        runs.push_back(i);
+        if (runs.size() > MAX_MERGE_RUNS) {
+          break; // too many to merge; the count no longer matters
+        }
+      }
+    }
+    runs.push_back(n);
+    return runs;
+  }
+
+  /** Merges adjacent runs pairwise in parallel until one remains. */
+  void merge_runs(Id *ids, Id *scratch, std::vector<size_t> runs) {
+    Id *src = ids, *dst = scratch;
+    while (runs.size() > 2) {
+      size_t n_pairs = (runs.size() - 1) / 2;
+      std::atomic<size_t> next(0);
+      run_threads([&] {
+        for (size_t p; (p = next++) < n_pairs;) {
+          size_t begin = runs[2 * p], mid = runs[2 * p + 1];
+          size_t end = runs[2 * p + 2];
+          std::merge(src + begin, src + mid, src + mid, src + end,
+                     dst + begin);
+        }
+      });
+      std::vector<size_t> merged;
+      for (size_t i = 0; i < runs.size(); i += 2) {
+        merged.push_back(runs[i]);
+      }
+      if (runs.size() % 2 == 0) {
+        // an odd run out is carried over unmerged
+        size_t begin = runs[runs.size() - 2], end = runs.back();
+        memcpy(dst + begin, src + begin, (end - begin) * sizeof(Id));
+        merged.push_back(end);
+      }
+      runs.swap(merged);
+      std::swap(src, dst);
+    }
+    if (src != ids) {
+      memcpy(ids, src, runs.back() * sizeof(Id));
+    }
+  }
+
+  /** Returns the shift of the 8-bit digit below the common prefix. */
+  static int digit_shift(const Id *ids, size_t n) {
+    u128 min = ids[0].to_u128(), max = min;
+    for (size_t i = 1; i < n; i++) {
+      u128 v = ids[i].to_u128();
+      min = v < min ? v : min;
+      max = v > max ? v : max;
+    }
+    return digit_shift(min, max);
+  }
+
+  /** Returns the shift of the 8-bit digit below the common prefix, or -1. */
+  static int digit_shift(u128 min, u128 max) {
+    u128 diff = min ^ max;
+    if (diff == 0) {
+      return -1; // all equal
+    }
+    uint64_t hi = (uint64_t)(diff >> 64);
+    int top = hi != 0 ? 127 - __builtin_clzll(hi)
+                      : 63 - __builtin_clzll((uint64_t)diff);
+    return top >= 7 ? top - 7 : 0;
+  }
+
+  static size_t digit(const Id &id, int shift) {
+    return (size_t)(id.to_u128() >> shift) & 0xff;
+  }
+
+  static void insertion_sort(Id *ids, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+      Id x = ids[i];
+      size_t j = i;
+      for (; j > 0 && x < ids[j - 1]; j--) {
+        ids[j] = ids[j - 1];
+      }
+      ids[j] = x;
+    }
+  }
+
+  /**
+   * Sorts `n` IDs from `data`, leaving the result in `scratch` if
+   * `to_scratch` is true or in `data` otherwise.
+   */
+  static void sort_range(Id *data, Id *scratch, size_t n, bool to_scratch) {
+    Id *out = to_scratch ? scratch : data;
+    if (n <= SMALL_RANGE) {
+      if (to_scratch) {
+        memcpy(scratch, data, n * sizeof(Id));
+      }
+      insertion_sort(out, n);
+      return;
+    }
+    int shift = digit_shift(data, n);
+    if (shift < 0) {
+      if (to_scratch) {
+        memcpy(scratch, data, n * sizeof(Id));
+      }
+      return;
+    }
+
+    size_t offsets[257] = {0};
+    for (size_t i = 0; i < n; i++) {
+      offsets[digit(data[i], shift) + 1]++;
+    }
+    for (int b = 0; b < 256; b++) {
+      offsets[b + 1] += offsets[b];
+    }
+    size_t heads[256];
+    memcpy(heads, offsets, sizeof(heads));
+    for (size_t i = 0; i < n; i++) {
+      scratch[heads[digit(data[i], shift)]++] = data[i];
+    }
+    for (int b = 0; b < 256; b++) {
+      size_t begin = offsets[b], count = offsets[b + 1] - begin;
+      if (count > 0) {
+        sort_range(scratch + begin, data + begin, count, !to_scratch);
+      }
+    }
+  }
+
+  /** Distributes the first pass among threads and then sorts the buckets. */
+  void sort_parallel(Id *ids, Id *scratch, size_t n) {
+    size_t n_chunks = n_threads_;
+    if (n_chunks == 1 || n < (size_t)1 << 16) {
+      sort_range(ids, scratch, n, false);
+      return;
+    }
+
+    std::vector<u128> mins(n_chunks, ~(u128)0), maxs(n_chunks, 0);
+    std::vector<size_t> counts(n_chunks * 256);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      size_t c = begin / chunk_size(n);
+      u128 min = ids[begin].to_u128(), max = min;
+      for (size_t i = begin + 1; i < end; i++) {
+        u128 v = ids[i].to_u128();
+        min = v < min ? v : min;
+        max = v > max ? v : max;
+      }
+      mins[c] = min;
+      maxs[c] = max;
+    });
+    int shift = digit_shift(*std::min_element(mins.begin(), mins.end()),
+                            *std::max_element(maxs.begin(), maxs.end()));
+    if (shift < 0) {
+      return; // all equal
+    }
+
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      size_t *count = &counts[256 * (begin / chunk_size(n))];
+      for (size_t i = begin; i < end; i++) {
+        count[digit(ids[i], shift)]++;
+      }
+    });
+    // turn the counts into the start of each bucket in each chunk
+    std::vector<size_t> offsets(257);
+    for (int b = 0; b < 256; b++) {
+      offsets[b + 1] = offsets[b];
+      for (size_t c = 0; c < n_chunks; c++) {
+        size_t count = counts[256 * c + b];
+        counts[256 * c + b] = offsets[b + 1];
+        offsets[b + 1] += count;
+      }
+    }
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      size_t *heads = &counts[256 * (begin / chunk_size(n))];
+      for (size_t i = begin; i < end; i++) {
+        scratch[heads[digit(ids[i], shift)]++] = ids[i];
+      }
+    });
+
+    // sort the buckets back into `ids`
+    for_each_bucket(offsets, [&](size_t begin, size_t count) {
+      sort_range(scratch + begin, ids + begin, count, true);
+    });
+  }
+
+  std::vector<Id> scratch_;
+};
+
+/**
+ * Sorts large arrays of textual IDs in the order of their values, ignoring
+ * case, with a most-significant-digit radix sort over the Base36 alphabet.
+ *
+ * The IDs are consecutive 26-byte records of 25 digits each followed by NUL
+ * or a line break, which moves with its record. Each character is mapped to
+ * its digit value through `DECODE_MAP`, which folds case; any other
+ * character maps to a 37th value that sorts after all digits, so records
+ * that are not valid IDs end up after valid ones sharing their prefix.
+ *
+ * The common prefix of all records is skipped first, as time-ordered IDs
+ * share their leading digits. The first pass is split among threads and
+ * distributes on the next two characters at once (37^2 buckets), which
+ * keeps enough buckets for the threads even when IDs span a short period
+ * and the first differing character takes only a few values; the buckets
+ * are then sorted by the threads in parallel, 37 ways per character, and
+ * ranges of `SMALL_RANGE` records or fewer are finished by insertion sort.
+ * Passes alternate between the array and a scratch buffer of the same size.
+ */
+class TextSorter : private ParallelSorter {
+ public:
+  /** Ranges of at most this many records are sorted by insertion sort. */
+  static constexpr size_t SMALL_RANGE = 32;
+
+  /**
+   * @param n_threads number of threads, or zero for the number of cores
+   */
+  explicit TextSorter(unsigned n_threads = 0) : ParallelSorter(n_threads) {}
+
+  /**
+   * Sorts `n` 26-byte records in place.
+   *
+   * @param texts `n` * 26-byte character array
+   * @param n number of records
+   */
+  void sort(char *texts, size_t n) {
+    if (n < 2) {
+      return;
+    }
+    scratch_.resize(RECORD * n);
+    char *scratch = scratch_.data();
+    size_t n_chunks = n_threads_;
+    int pos = common_prefix(texts, n);
+    if (n_chunks == 1 || n < (size_t)1 << 16 || pos >= 24) {
+      sort_range(texts, scratch, n, pos, false);
+      return;
+    }
+
+    const size_t N_BUCKETS = RADIX * RADIX;
+    std::vector<size_t> counts(n_chunks * N_BUCKETS);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      size_t *count = &counts[N_BUCKETS * (begin / chunk_size(n))];
+      for (size_t i = begin; i < end; i++) {
+        count[pair_key(texts + RECORD * i, pos)]++;
+      }
+    });
+    std::vector<size_t> offsets(N_BUCKETS + 1);
+    for (size_t b = 0; b < N_BUCKETS; b++) {
+      offsets[b + 1] = offsets[b];
+      for (size_t c = 0; c < n_chunks; c++) {
+        size_t count = counts[N_BUCKETS * c + b];
+        counts[N_BUCKETS * c + b] = offsets[b + 1];
+        offsets[b + 1] += count;
+      }
+    }
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      size_t *heads = &counts[N_BUCKETS * (begin / chunk_size(n))];
+      for (size_t i = begin; i < end; i++) {
+        const char *record = texts + RECORD * i;
+        memcpy(scratch + RECORD * heads[pair_key(record, pos)]++, record,
+               RECORD);
+      }
+    });
+
+    for_each_bucket(offsets, [&](size_t begin, size_t count) {
+      sort_range(scratch + RECORD * begin, texts + RECORD * begin, count,
+                 pos + 2, true);
+    });
+  }
+
+  /** Releases the scratch buffer kept between calls. */
+  void release() { std::vector<char>().swap(scratch_); }
+
+ private:
+  static constexpr size_t RECORD = 26;
+
+  /** Number of distinct keys: 36 digits and any other character. */
+  static constexpr size_t RADIX = 37;
+
+  static size_t key(char c) {
+    uint8_t value = DECODE_MAP[(unsigned char)c];
+    return value < 36 ? value : 36;
+  }
+
+  static size_t pair_key(const char *record, int pos) {
+    return key(record[pos]) * RADIX + key(record[pos + 1]);
+  }
+
+  /** Returns the length of the prefix shared by all records, in keys. */
+  int common_prefix(const char *texts, size_t n) {
+    std::vector<int> lengths(n_threads_, 25);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+      int len = 25;
+      for (size_t i = begin; i < end && len > 0; i++) {
+        const char *record = texts + RECORD * i;
+        int j = 0;
+        while (j < len && key(record[j]) == key(texts[j])) {
+          j++;
+        }
+        len = j;
+      }
+      lengths[begin / chunk_size(n)] = len;
+    });
+    return *std::min_element(lengths.begin(), lengths.end());
+  }
+
+  /** Returns true if record `a` is less than `b` from position `pos`. */
+  static bool less(const char *a, const char *b, int pos) {
+    for (; pos < 25; pos++) {
+      size_t ka = key(a[pos]), kb = key(b[pos]);
+      if (ka != kb) {
+        return ka < kb;
+      }
+    }
+    return false;
+  }
+
+  static void insertion_sort(char *texts, size_t n, int pos) {
+    for (size_t i = 1; i < n; i++) {
+      char x[RECORD];
+      memcpy(x, texts + RECORD * i, RECORD);
+      size_t j = i;
+      while (j > 0 && less(x, texts + RECORD * (j - 1), pos)) {
+        j--;
+      }
+      if (j < i) {
+        memmove(texts + RECORD * (j + 1), texts + RECORD * j,
+                RECORD * (i - j));
+        memcpy(texts + RECORD * j, x, RECORD);
+      }
+    }
+  }
+
+  /**
+   * Sorts `n` records from `data` that are equal before position `pos`,
+   * leaving the result in `scratch` if `to_scratch` is true or in `data`
+   * otherwise.
+   */
+  static void sort_range(char *data, char *scratch, size_t n, int pos,
+                         bool to_scratch) {
+    size_t counts[RADIX];
+    for (;; pos++) {
+      if (n <= SMALL_RANGE || pos >= 25) {
+        if (to_scratch) {
+          memcpy(scratch, data, RECORD * n);
+        }
+        insertion_sort(to_scratch ? scratch : data, n, pos);
+        return;
+      }
+      memset(counts, 0, sizeof(counts));
+      for (size_t i = 0; i < n; i++) {
+        counts[key(data[RECORD * i + pos])]++;
+      }
+      if (counts[key(data[pos])] < n) {
+        break; // otherwise, skip the character shared by all records
+      }
+    }
+
+    size_t offsets[RADIX + 1] = {0};
+    for (size_t b = 0; b < RADIX; b++) {
+      offsets[b + 1] = offsets[b] + counts[b];
+    }
+    size_t heads[RADIX];
+    memcpy(heads, offsets, sizeof(heads));
+    for (size_t i = 0; i < n; i++) {
+      const char *record = data + RECORD * i;
+      memcpy(scratch + RECORD * heads[key(record[pos])]++, record, RECORD);
+    }
+    for (size_t b = 0; b < RADIX; b++) {
+      size_t begin = offsets[b], count = offsets[b + 1] - begin;
+      if (count > 0) {
+        sort_range(scratch + RECORD * begin, data + RECORD * begin, count,
+                   pos + 1, !to_scratch);
+      }
+    }
+  }
+
+  std::vector<char> scratch_;
+};
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_SORT_HPP */
@@ -0,0 +1,255 @@
+/** sort_test.cpp - Tests for sort.hpp */
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "codec.hpp"
+#include "id.hpp"
+#include "random.hpp"
+#include "sort.hpp"
+#include "test_fixtures.hpp"
+#include "text.hpp"
+
+using namespace scru128;
+
+/**
+ * Generates `n` IDs from each of `n_gens` generators, one per millisecond
+ * every `ids_per_ms` IDs, concatenated generator by generator.
+ */
+static std::vector<Id> generate_runs(int n_gens, size_t n,
+                                     uint64_t ids_per_ms) {
+  std::vector<Id> ids;
+  for (int k = 0; k < n_gens; k++) {
+    std::vector<Id> run = generate_ids(n, ids_per_ms, k);
+    ids.insert(ids.end(), run.begin(), run.end());
+  }
+  return ids;
+}
+
+/** Sorts a copy with `IdSorter` and checks it against `std::sort`. */
+static void check_sort(const std::vector<Id> &input, unsigned n_threads) {
+  std::vector<Id> expected(input), actual(input);
+  std::sort(expected.begin(), expected.end());
+  IdSorter(n_threads).sort(actual.data(), actual.size());
+  assert(actual == expected);
+}
+
+/** Sorts random, duplicate, and degenerate inputs. */
+static void test_sort(void) {
+  WyrandRandom rng(1);
+  for (size_t n : {0, 1, 2, 47, 48, 49, 1000, 100000}) {
+    std::vector<Id> random(n);
+    for (Id &id : random) {
+      id = Id{rng.next_u64(), rng.next_u64()};
+    }
+    for (unsigned t : {1, 3}) {
+      check_sort(random, t);
+    }
+
+    std::vector<Id> narrow(n);
+    for (Id &id : narrow) {
+      // differ in a few low bits of each word only, with many duplicates
+      id = Id{T << 16 | (rng.next_u64() & 3), rng.next_u64() & 0x70};
+    }
+    check_sort(narrow, 2);
+  }
+
+  std::vector<Id> equal(100000, Id::from_fields(T, 1, 2, 3));
+  check_sort(equal, 4);
+  std::vector<Id> reversed = generate_runs(1, 100000, 10);
+  std::reverse(reversed.begin(), reversed.end());
+  check_sort(reversed, 4);
+}
+
+/** Merges runs of sorted IDs and sorts interleaved streams. */
+static void test_runs(void) {
+  for (int n_gens : {1, 2, 7, 32, 33, 100}) {
+    std::vector<Id> ids = generate_runs(n_gens, 5000, 10);
+    check_sort(ids, 1);
+    check_sort(ids, 4);
+  }
+}
+
+/** Sorts binary IDs in place. */
+static void test_sort_binary(void) {
+  WyrandRandom rng(2);
+  const size_t N = 100000;
+  std::vector<uint8_t> bytes(16 * N);
+  for (size_t i = 0; i < bytes.size(); i += 8) {
+    uint64_t r = rng.next_u64();
+    memcpy(&bytes[i], &r, 8);
+  }
+  std::vector<uint8_t> expected(bytes);
+  std::vector<size_t> order(N);
+  for (size_t i = 0; i < N; i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return memcmp(&expected[16 * a], &expected[16 * b], 16) < 0;
+  });
+  IdSorter sorter(2);
+  sorter.sort_binary(bytes.data(), N);
+  for (size_t i = 0; i < N; i++) {
+    assert(memcmp(&bytes[16 * i], &expected[16 * order[i]], 16) == 0);
+  }
+}
+
+typedef std::array<char, 26> Record;
+
+/** Returns records of `ids` as text, with random letters in uppercase. */
+static std::vector<Record> to_records(const std::vector<Id> &ids,
+                                      uint64_t seed) {
+  WyrandRandom rng(seed);
+  std::vector<Record> records(ids.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    ids[i].encode(records[i].data());
+    uint64_t bits = rng.next_u64();
+    for (int j = 0; j < 25; j++) {
+      char &c = records[i][j];
+      c = c >= 'a' && (bits >> j & 1) ? (char)(c - 32) : c;
+    }
+    records[i][25] = '\n';
+  }
+  return records;
+}
+
+/** Orders records as `TextSorter` does, with non-digits after digits. */
+static bool record_less(const Record &a, const Record &b) {
+  for (int i = 0; i < 25; i++) {
+    int ka = DECODE_MAP[(unsigned char)a[i]];
+    int kb = DECODE_MAP[(unsigned char)b[i]];
+    if (ka != kb) {
+      return ka < kb;
+    }
+  }
+  return false;
+}
+
+/** Sorts records with `TextSorter` and checks them against `std::sort`. */
+static void check_sort_text(const std::vector<Record> &input,
+                            unsigned n_threads) {
+  std::vector<Record> expected(input), actual(input);
+  std::stable_sort(expected.begin(), expected.end(), record_less);
+  TextSorter(n_threads).sort(actual[0].data(), actual.size());
+  for (size_t i = 0; i < input.size(); i++) {
+    assert(!record_less(actual[i], expected[i]) &&
+           !record_less(expected[i], actual[i]));
+  }
+  std::sort(expected.begin(), expected.end());
+  std::sort(actual.begin(), actual.end());
+  assert(actual == expected); // the same records, case and all
+}
+
+/** Sorts mixed-case, time-ordered, and invalid textual IDs. */
+static void test_sort_text(void) {
+  WyrandRandom rng(4);
+  for (size_t n : {2, 31, 33, 1000, 100000}) {
+    std::vector<Id> random(n);
+    for (Id &id : random) {
+      id = Id{rng.next_u64(), rng.next_u64()};
+    }
+    std::vector<Record> records = to_records(random, n);
+    check_sort_text(records, 1);
+    check_sort_text(records, 3);
+  }
+
+  std::vector<Id> ids = generate_runs(50, 4000, 10);
+  std::vector<Record> records = to_records(ids, 1);
+  check_sort_text(records, 1);
+  check_sort_text(records, 4);
+
+  // duplicates and records that are not IDs
+  for (size_t i = 0; i < records.size(); i += 97) {
+    records[i] = records[i / 2];
+  }
+  for (size_t i = 1; i < records.size(); i += 101) {
+    records[i][i % 25] = "+-@[ \xff"[i % 6];
+  }
+  check_sort_text(records, 1);
+  check_sort_text(records, 4);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Compares `std::sort` and `IdSorter` with 1-8 threads on IDs from 1000
+ * generators, shuffled and concatenated, and on 8 sorted runs, and then
+ * `std::sort` with `compare_text()` and `TextSorter` on the first two as
+ * mixed-case text. Set `SORT_BENCH_MAX` to the largest size to try (default
+ * 1e7; 1e9 IDs need 32 GB of memory, and 1e8 text IDs about 8 GB).
+ */
+static void run_benchmarks(void) {
+  const char *env = getenv("SORT_BENCH_MAX");
+  size_t max_n = env != nullptr ? (size_t)atof(env) : 10000000;
+  for (size_t n = 1000000; n <= max_n; n *= 10) {
+    std::vector<Id> base = generate_runs(1000, n / 1000, 1);
+    WyrandRandom rng(3);
+    std::vector<Id> shuffled(base);
+    for (size_t i = n - 1; i > 0; i--) {
+      std::swap(shuffled[i], shuffled[rng.next_u64() % (i + 1)]);
+    }
+    std::vector<Id> runs = generate_runs(8, n / 8, 1000);
+
+    const std::vector<Id> *inputs[] = {&shuffled, &base, &runs};
+    const char *names[] = {"shuffled", "per-generator", "8 runs"};
+    for (int k = 0; k < 3; k++) {
+      std::vector<Id> work(*inputs[k]);
+      uint64_t start = now_ns();
+      std::sort(work.begin(), work.end());
+      printf("%9zu %-13s std::sort %8.1f ms", n, names[k],
+             (double)(now_ns() - start) / 1e6);
+      for (unsigned t = 1; t <= 8; t *= 2) {
+        work = *inputs[k];
+        IdSorter sorter(t);
+        start = now_ns();
+        sorter.sort(work.data(), n);
+        printf("  %u: %7.1f ms", t, (double)(now_ns() - start) / 1e6);
+      }
+      printf("\n");
+    }
+
+    std::vector<Record> texts[] = {to_records(shuffled, 1),
+                                   to_records(base, 1)};
+    for (int k = 0; k < 2; k++) {
+      std::vector<Record> work(texts[k]);
+      uint64_t start = now_ns();
+      std::sort(work.begin(), work.end(), [](const Record &a, const Record &b) {
+        return compare_text(a.data(), b.data()) < 0;
+      });
+      printf("%9zu %-13s text std::sort %8.1f ms", n, names[k],
+             (double)(now_ns() - start) / 1e6);
+      for (unsigned t = 1; t <= 8; t *= 2) {
+        work = texts[k];
+        TextSorter sorter(t);
+        start = now_ns();
+        sorter.sort(work[0].data(), n);
+        printf("  %u: %7.1f ms", t, (double)(now_ns() - start) / 1e6);
+      }
+      printf("\n");
+    }
+  }
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_sort();
+  test_runs();
+  test_sort_binary();
+  test_sort_text();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
@@ -0,0 +1,68 @@
+/** test_fixtures.hpp - Clock, random, and data fixtures for tests */
+
+#ifndef SCRU128_TEST_FIXTURES_HPP
+#define SCRU128_TEST_FIXTURES_HPP
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "generator.hpp"
+#include "id.hpp"
+#include "random.hpp"
+
+namespace scru128 {
+
+/** Timestamp at which test data starts (2022-04-03T08:17:16.097Z). */
+constexpr uint64_t T = 0x017fee7fef41;
+
+/** Clock that returns a timestamp set by the test. */
+struct FixedClock {
+  uint64_t now = 0;
+  uint64_t now_ms() { return now; }
+};
+
+/** Random source that returns all-one bits to trigger counter overflows. */
+struct MaxRandom {
+  int fill(void *buf, size_t len) {
+    memset(buf, 0xff, len);
+    return 0;
+  }
+};
+
+/**
+ * Generates `n` IDs in generator order from `T`, one millisecond every
+ * `ids_per_ms` IDs, with a generator seeded with `seed`.
+ */
+inline std::vector<Id> generate_ids(size_t n, uint64_t ids_per_ms,
+                                    uint64_t seed = 1) {
+  DeterministicGenerator g(VirtualClock(T, ids_per_ms), WyrandRandom(seed));
+  std::vector<Id> ids(n);
+  for (Id &id : ids) {
+    uint8_t bytes[16];
+    g.generate(bytes);
+    id = Id::from_bytes(bytes);
+  }
+  return ids;
+}
+
+/** Returns a descriptor of an unlinked temporary file holding `data`. */
+inline int temp_file(const std::string &data = std::string()) {
+  char path[] = "/tmp/scru128-test-XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+  assert(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  return fd;
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_TEST_FIXTURES_HPP */
@@ -0,0 +1,184 @@
+/** text.hpp - Case-insensitive comparison and canonicalization of text IDs
+ *
+ * The textual form of SCRU128 IDs is case-insensitive, and IDs must be
+ * compared without regard to case to sort in the order of their values. For
+ * Base36 digit characters, setting bit 5 (`| 0x20`) folds uppercase letters
+ * into lowercase and leaves the decimal digits, which already have the bit
+ * set, intact, so that 25 digits are folded and compared in a few vector
+ * instructions without copying them.
+ */
+
+#ifndef SCRU128_TEXT_HPP
+#define SCRU128_TEXT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace scru128 {
+
+/** Textual form of the maximum ID, the greatest valid 25-digit string. */
+constexpr char MAX_TEXT[] = "f5lxx1zz5pnorynqglhzmsp33";
+
+#ifdef __SSE2__
+/** 25 digits folded into lowercase, as bytes 0-15 and 9-24. */
+struct FoldedText {
+  __m128i head;
+  __m128i tail;
+
+  /** Loads 25 digits; all the 25 bytes must be readable. */
+  static FoldedText load(const char *text) {
+    const __m128i CASE_BIT = _mm_set1_epi8(0x20);
+    return FoldedText{
+        _mm_or_si128(_mm_loadu_si128((const __m128i *)text), CASE_BIT),
+        _mm_or_si128(_mm_loadu_si128((const __m128i *)(text + 9)), CASE_BIT)};
+  }
+};
+
+/**
+ * Returns a bit mask whose bit `k` is set if byte `k` of `a` is greater than
+ * that of `b`. The signed comparison is exact for ASCII characters.
+ */
+inline uint32_t greater_bytes(const FoldedText &a, const FoldedText &b) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(a.head, b.head)) |
+         (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(a.tail, b.tail)) << 9;
+}
+
+/** Returns true if folded digits `a` are less than `b`. */
+inline bool less_folded(const FoldedText &a, const FoldedText &b) {
+  uint32_t greater = greater_bytes(a, b), less = greater_bytes(b, a);
+  // the lowest set bit of either mask marks the first differing byte
+  return (less & (greater | less) & -(greater | less)) != 0;
+}
+
+/** Compares folded digits like `compare_text()`. */
+inline int compare_folded(const FoldedText &a, const FoldedText &b) {
+  uint32_t greater = greater_bytes(a, b), less = greater_bytes(b, a);
+  // the lowest set bit of either mask marks the first differing byte
+  uint32_t first = (greater | less) & -(greater | less);
+  return (int)((greater & first) != 0) - (int)((less & first) != 0);
+}
+#endif /* #ifdef __SSE2__ */
+
+/**
+ * Compares two 25-digit Base36 strings case-insensitively in the order of
+ * their values. With SSE2, the comparison takes two overlapping 16-byte loads
+ * per string and no branches.
+ *
+ * @param a 25-byte character array
+ * @param b 25-byte character array
+ * @return negative, zero, or positive as `a` is less than, equal to, or
+ * greater than `b`
+ */
+inline int compare_text(const char *a, const char *b) {
+#ifdef __SSE2__
+  return compare_folded(FoldedText::load(a), FoldedText::load(b));
+#else
+  for (int i = 0; i < 25; i++) {
+    int diff = (int)(unsigned char)(a[i] | 0x20) -
+               (int)(unsigned char)(b[i] | 0x20);
+    if (diff != 0) {
+      return diff;
+    }
+  }
+  return 0;
+#endif /* #ifdef __SSE2__ */
+}
+
+/** Comparison object for sorting pointers to textual IDs with `std::sort`. */
+struct TextLess {
+  bool operator()(const char *a, const char *b) const {
+#ifdef __SSE2__
+    return less_folded(FoldedText::load(a), FoldedText::load(b));
+#else
+    return compare_text(a, b) < 0;
+#endif
+  }
+};
+
+/**
+ * Converts `n` consecutive 26-byte records of 25 Base36 digits each
+ * (followed by NUL or a line break, which is not read) into lowercase in
+ * place, and validates them as `decode()` does: every byte must be a digit
+ * character and the value must fit in 128 bits. Invalid records are left
+ * unmodified.
+ *
+ * @param texts `n` * 26-byte character array
+ * @param n number of records
+ * @param valid receives `n` flags, one if the record is valid or zero
+ * otherwise; may be null
+ * @return number of invalid records
+ */
+inline size_t canonicalize_text(char *texts, size_t n, uint8_t *valid) {
+  size_t invalid = 0;
+#ifdef __SSE2__
+  const FoldedText max = FoldedText::load(MAX_TEXT);
+  const __m128i CASE_BIT = _mm_set1_epi8(0x20);
+  const __m128i BEFORE_0 = _mm_set1_epi8('0' - 1);
+  const __m128i AFTER_9 = _mm_set1_epi8('9' + 1);
+  const __m128i BEFORE_A = _mm_set1_epi8('a' - 1);
+  const __m128i AFTER_Z = _mm_set1_epi8('z' + 1);
+  for (size_t i = 0; i < n; i++) {
+    char *text = texts + 26 * i;
+    __m128i raw[2] = {_mm_loadu_si128((const __m128i *)text),
+                      _mm_loadu_si128((const __m128i *)(text + 9))};
+    FoldedText folded = {_mm_or_si128(raw[0], CASE_BIT),
+                         _mm_or_si128(raw[1], CASE_BIT)};
+    __m128i letters[2];
+    uint32_t masks[2];
+    for (int j = 0; j < 2; j++) {
+      __m128i f = j == 0 ? folded.head : folded.tail;
+      // bytes from 0x80 are negative and fall outside both ranges
+      __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(raw[j], BEFORE_0),
+                                    _mm_cmpgt_epi8(AFTER_9, raw[j]));
+      letters[j] = _mm_and_si128(_mm_cmpgt_epi8(f, BEFORE_A),
+                                 _mm_cmpgt_epi8(AFTER_Z, f));
+      masks[j] =
+          (uint32_t)_mm_movemask_epi8(_mm_or_si128(digit, letters[j]));
+    }
+    bool ok = (masks[0] & masks[1]) == 0xffff &&
+              compare_folded(folded, max) <= 0;
+    if (ok) {
+      // set the case bit of letters only; digits keep theirs
+      _mm_storeu_si128((__m128i *)(text + 9),
+                       _mm_or_si128(raw[1], _mm_and_si128(letters[1],
+                                                          CASE_BIT)));
+      _mm_storeu_si128((__m128i *)text,
+                       _mm_or_si128(raw[0], _mm_and_si128(letters[0],
+                                                          CASE_BIT)));
+    }
+    invalid += !ok;
+    if (valid != nullptr) {
+      valid[i] = ok;
+    }
+  }
+#else
+  for (size_t i = 0; i < n; i++) {
+    char *text = texts + 26 * i;
+    bool ok = true;
+    for (int j = 0; j < 25; j++) {
+      char c = text[j];
+      char f = (char)(c | 0x20);
+      ok &= (c >= '0' && c <= '9') || (f >= 'a' && f <= 'z');
+    }
+    ok = ok && compare_text(text, MAX_TEXT) <= 0;
+    if (ok) {
+      for (int j = 0; j < 25; j++) {
+        text[j] = (char)(text[j] | 0x20);
+      }
+    }
+    invalid += !ok;
+    if (valid != nullptr) {
+      valid[i] = ok;
+    }
+  }
+#endif /* #ifdef __SSE2__ */
+  return invalid;
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_TEXT_HPP */
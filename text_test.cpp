@@ -0,0 +1,172 @@
+/** text_test.cpp - Tests for text.hpp
+ *
+ * Compile with `-mno-sse2` on x86 (or on other platforms) to test the scalar
+ * path.
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "codec.hpp"
+#include "id.hpp"
+#include "random.hpp"
+#include "text.hpp"
+
+using namespace scru128;
+
+/**
+ * Generates `n` random IDs as 26-byte records, with the case of each letter
+ * chosen at random if `mixed_case` is true.
+ */
+static std::vector<char> random_texts(size_t n, bool mixed_case,
+                                      uint64_t seed) {
+  WyrandRandom rng(seed);
+  std::vector<char> texts(26 * n);
+  for (size_t i = 0; i < n; i++) {
+    char *text = &texts[26 * i];
+    Id::from_u128((unsigned __int128)rng.next_u64() << 64 | rng.next_u64())
+        .encode(text);
+    uint64_t bits = rng.next_u64();
+    if (mixed_case) {
+      for (int j = 0; j < 25; j++) {
+        if (text[j] >= 'a' && (bits >> j & 1)) {
+          text[j] = (char)(text[j] - 32);
+        }
+      }
+    }
+  }
+  return texts;
+}
+
+/** Returns the sign of an integer. */
+static int sign(int x) { return (x > 0) - (x < 0); }
+
+/** Compares mixed-case text in the order of the values. */
+static void test_compare_text(void) {
+  const size_t N = 2000;
+  std::vector<char> texts = random_texts(N, true, 1);
+  std::vector<char> lower = random_texts(N, false, 1);
+  for (size_t i = 0; i < N; i++) {
+    Id a, b;
+    assert(Id::decode(&texts[26 * i], &a) == 0);
+    assert(compare_text(&texts[26 * i], &lower[26 * i]) == 0);
+    for (size_t j = i; j < i + 5 && j < N; j++) {
+      assert(Id::decode(&texts[26 * j], &b) == 0);
+      int expected = (a > b) - (a < b);
+      assert(sign(compare_text(&texts[26 * i], &texts[26 * j])) == expected);
+      assert(sign(compare_text(&texts[26 * j], &lower[26 * i])) == -expected);
+    }
+  }
+
+  // the first differing byte at each position decides the order
+  for (int k = 0; k < 25; k++) {
+    char a[26] = "0000000000000000000000000";
+    char b[26] = "0000000000000000000000000";
+    a[k] = 'A';
+    b[k] = '9';
+    b[24] = 'z';
+    assert(compare_text(a, b) > 0 || k == 24);
+    assert(compare_text(b, a) < 0 || k == 24);
+  }
+  assert(compare_text("F5LXX1ZZ5PNORYNQGLHZMSP33", MAX_TEXT) == 0);
+
+  std::vector<const char *> ptrs;
+  for (size_t i = 0; i < N; i++) {
+    ptrs.push_back(&texts[26 * i]);
+  }
+  std::sort(ptrs.begin(), ptrs.end(), TextLess());
+  for (size_t i = 1; i < N; i++) {
+    Id a = {0, 0}, b = {0, 0};
+    Id::decode(ptrs[i - 1], &a);
+    Id::decode(ptrs[i], &b);
+    assert(a < b);
+  }
+}
+
+/** Converts valid records to lowercase and leaves invalid ones intact. */
+static void test_canonicalize_text(void) {
+  const size_t N = 1000;
+  std::vector<char> texts = random_texts(N, true, 2);
+  std::vector<char> expected = random_texts(N, false, 2);
+  const char *invalid[] = {
+      "0372hg16csmsm50l8dikcvuk+", "+372hg16csmsm50l8dikcvukc",
+      "0372hg16csmsm50l8dikc\x10ukc", "0372hg16cs\xe1sm50l8dikcvukc",
+      "0372hg16csmsm50l8di@cvukc", "f5lxx1zz5pnorynqglhzmsp34",
+      "F5LXX1ZZ5PNORYNQGLHZMSP34", "zzzzzzzzzzzzzzzzzzzzzzzzz"};
+  for (size_t k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++) {
+    memcpy(&texts[26 * (10 * k + 3)], invalid[k], 26);
+    memcpy(&expected[26 * (10 * k + 3)], invalid[k], 26);
+  }
+  memcpy(&texts[26 * 500], "F5LXX1ZZ5PNORYNQGLHZMSP33", 26);
+  memcpy(&expected[26 * 500], MAX_TEXT, 26);
+
+  std::vector<uint8_t> valid(N);
+  assert(canonicalize_text(texts.data(), N, valid.data()) == 8);
+  assert(texts == expected);
+  for (size_t i = 0; i < N; i++) {
+    uint8_t bytes[16];
+    assert(valid[i] == (decode(&texts[26 * i], bytes) == 0));
+  }
+  assert(canonicalize_text(texts.data(), N, nullptr) == 8);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Sorts a million mixed-case IDs by lowercasing copies, by comparing them
+ * case-insensitively in place, and by canonicalizing them first.
+ */
+static void run_benchmarks(void) {
+  const size_t N = 1000000;
+  const std::vector<char> texts = random_texts(N, true, 3);
+  std::vector<const char *> ptrs(N);
+
+  uint64_t start = now_ns();
+  std::vector<char> copies(texts);
+  for (char &c : copies) {
+    c = c >= 'A' && c <= 'Z' ? (char)(c + 32) : c;
+  }
+  for (size_t i = 0; i < N; i++) {
+    ptrs[i] = &copies[26 * i];
+  }
+  std::sort(ptrs.begin(), ptrs.end(), [](const char *a, const char *b) {
+    return memcmp(a, b, 25) < 0;
+  });
+  double copy_ms = (double)(now_ns() - start) / 1e6;
+
+  start = now_ns();
+  for (size_t i = 0; i < N; i++) {
+    ptrs[i] = &texts[26 * i];
+  }
+  std::sort(ptrs.begin(), ptrs.end(), TextLess());
+  double compare_ms = (double)(now_ns() - start) / 1e6;
+
+  std::vector<char> work(texts);
+  start = now_ns();
+  canonicalize_text(work.data(), N, nullptr);
+  double canonicalize_ms = (double)(now_ns() - start) / 1e6;
+
+  printf("sort 1M mixed-case IDs via lowercase copies: %6.1f ms  "
+         "TextLess: %6.1f ms  (canonicalize_text: %5.2f ms)\n",
+         copy_ms, compare_ms, canonicalize_ms);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_compare_text();
+  test_canonicalize_text();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}
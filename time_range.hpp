@@ -0,0 +1,116 @@
+/** time_range.hpp - Time-range bounds and filtering of IDs without decoding
+ *
+ * As the textual and binary forms of SCRU128 IDs sort like the 128-bit
+ * integers, the IDs whose `timestamp` is in `[t0, t1)` are exactly those in
+ * `[t0 << 80, t1 << 80)`, and a time predicate reduces to two comparisons with
+ * precomputed bounds in whichever form the IDs are stored.
+ */
+
+#ifndef SCRU128_TIME_RANGE_HPP
+#define SCRU128_TIME_RANGE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "id.hpp"
+#include "text.hpp"
+
+namespace scru128 {
+
+/** Half-open range of IDs covering a half-open range of timestamps. */
+struct TimeRange {
+  /** Least ID in the range. */
+  Id lower;
+
+  /** Least ID above the range. */
+  Id upper;
+
+  /**
+   * Returns the range of IDs whose `timestamp` is in `[t0, t1)`. Both ends are
+   * clamped to `2^48 - 1`, which only reserved IDs have, so that the bounds
+   * are representable; an empty range results if `t1 <= t0`.
+   */
+  static constexpr TimeRange from_timestamps(uint64_t t0, uint64_t t1) {
+    t0 = t0 < MAX_TIMESTAMP ? t0 : MAX_TIMESTAMP;
+    t1 = t1 < MAX_TIMESTAMP ? t1 : MAX_TIMESTAMP;
+    t1 = t1 > t0 ? t1 : t0;
+    return TimeRange{Id::from_fields(t0, 0, 0, 0),
+                     Id::from_fields(t1, 0, 0, 0)};
+  }
+
+  /** Returns true if the range contains an ID. */
+  constexpr bool contains(const Id &id) const {
+    return lower <= id && id < upper;
+  }
+
+  /**
+   * Writes the bounds in the textual form, for comparison with textual IDs
+   * by `compare_text()` or `filter_text()` (or by `strcmp()` if the IDs are
+   * known to be lowercase).
+   *
+   * @param lower_out 26-byte string that receives the inclusive lower bound
+   * @param upper_out 26-byte string that receives the exclusive upper bound
+   */
+  constexpr void text_bounds(char *lower_out, char *upper_out) const {
+    lower.encode(lower_out);
+    upper.encode(upper_out);
+  }
+
+  /**
+   * Writes the bounds in the binary form, for comparison with binary IDs by
+   * `memcmp()`.
+   *
+   * @param lower_out 16-byte byte array that receives the inclusive lower
+   * bound
+   * @param upper_out 16-byte byte array that receives the exclusive upper
+   * bound
+   */
+  constexpr void binary_bounds(uint8_t *lower_out, uint8_t *upper_out) const {
+    lower.to_bytes(lower_out);
+    upper.to_bytes(upper_out);
+  }
+};
+
+/**
+ * Tests `n` consecutive 26-byte records of 25 Base36 digits each (followed by
+ * NUL or a line break, which is not read) against textual bounds from
+ * `TimeRange::text_bounds()`, ignoring case.
+ *
+ * Each record is compared with both bounds by `compare_text()`, which with
+ * SSE2 takes two overlapping 16-byte loads and no branches; the bounds are
+ * loaded only once.
+ *
+ * @param texts `n` * 26-byte character array
+ * @param n number of records
+ * @param lower 25-digit inclusive lower bound
+ * @param upper 25-digit exclusive upper bound
+ * @param matches receives `n` flags, one if the record is in `[lower, upper)`
+ * or zero otherwise
+ * @return number of records in `[lower, upper)`
+ */
+inline size_t filter_text(const char *texts, size_t n, const char *lower,
+                          const char *upper, uint8_t *matches) {
+  size_t count = 0;
+#ifdef __SSE2__
+  const FoldedText lower_digits = FoldedText::load(lower);
+  const FoldedText upper_digits = FoldedText::load(upper);
+  for (size_t i = 0; i < n; i++) {
+    FoldedText text = FoldedText::load(texts + 26 * i);
+    matches[i] = !less_folded(text, lower_digits) &
+                 less_folded(text, upper_digits);
+    count += matches[i];
+  }
+#else
+  for (size_t i = 0; i < n; i++) {
+    const char *text = texts + 26 * i;
+    matches[i] =
+        compare_text(text, lower) >= 0 && compare_text(text, upper) < 0;
+    count += matches[i];
+  }
+#endif /* #ifdef __SSE2__ */
+  return count;
+}
+
+} // namespace scru128
+
+#endif /* #ifndef SCRU128_TIME_RANGE_HPP */
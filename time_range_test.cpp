@@ -0,0 +1,164 @@
+/** time_range_test.cpp - Tests for time_range.hpp
+ *
+ * Compile with `-mno-sse2` on x86 (or on other platforms) to test the scalar
+ * path.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "codec.hpp"
+#include "id.hpp"
+#include "test_fixtures.hpp"
+#include "time_range.hpp"
+
+using namespace scru128;
+
+/** Generates `n` IDs over `n / ids_per_ms` milliseconds from `T` as text. */
+static std::vector<char> generate_texts(size_t n, uint64_t ids_per_ms) {
+  std::vector<Id> ids = generate_ids(n, ids_per_ms);
+  std::vector<char> texts(26 * n);
+  for (size_t i = 0; i < n; i++) {
+    ids[i].encode(&texts[26 * i]);
+  }
+  return texts;
+}
+
+/** Computes bounds in every form that agree with `contains()`. */
+static void test_bounds(void) {
+  TimeRange range = TimeRange::from_timestamps(T, T + 10);
+  assert(range.contains(Id::from_fields(T, 0, 0, 0)));
+  assert(range.contains(Id::from_fields(T + 9, 0xffffff, 0xffffff, ~0u)));
+  assert(!range.contains(Id::from_fields(T - 1, 0xffffff, 0xffffff, ~0u)));
+  assert(!range.contains(Id::from_fields(T + 10, 0, 0, 0)));
+
+  char lower[26], upper[26];
+  range.text_bounds(lower, upper);
+  uint8_t lower_bytes[16], upper_bytes[16];
+  range.binary_bounds(lower_bytes, upper_bytes);
+  for (uint64_t t = T - 2; t < T + 12; t++) {
+    Id id = Id::from_fields(t, 0x123456, 0x789abc, 0xdef01234);
+    char text[26];
+    id.encode(text);
+    uint8_t bytes[16];
+    id.to_bytes(bytes);
+    bool in_text = strcmp(text, lower) >= 0 && strcmp(text, upper) < 0;
+    bool in_binary = memcmp(bytes, lower_bytes, 16) >= 0 &&
+                     memcmp(bytes, upper_bytes, 16) < 0;
+    assert(in_text == range.contains(id) && in_binary == range.contains(id));
+    assert(range.contains(id) == (t >= T && t < T + 10));
+  }
+
+  TimeRange all = TimeRange::from_timestamps(1, UINT64_MAX);
+  assert(all.upper == Id::from_fields(0xffffffffffff, 0, 0, 0));
+  assert(!all.contains(MAX_ID) && !all.contains(MIN_ID));
+  TimeRange empty = TimeRange::from_timestamps(T, T - 5);
+  assert(!empty.contains(empty.lower));
+}
+
+/** Filters text against bounds as decoding and comparing would. */
+static void test_filter_text(void) {
+  const size_t N = 10000;
+  std::vector<char> texts = generate_texts(N, 100);
+  uint64_t t0s[] = {0, T, T + 17, T + 99, T + 100};
+  uint64_t t1s[] = {T + 1, T + 50, T + 99, UINT64_MAX};
+  for (uint64_t t0 : t0s) {
+    for (uint64_t t1 : t1s) {
+      TimeRange range = TimeRange::from_timestamps(t0, t1);
+      char lower[26], upper[26];
+      range.text_bounds(lower, upper);
+      std::vector<uint8_t> matches(N, 0xff);
+      size_t count = filter_text(texts.data(), N, lower, upper,
+                                 matches.data());
+
+      size_t expected_count = 0;
+      for (size_t i = 0; i < N; i++) {
+        Id id;
+        assert(Id::decode(&texts[26 * i], &id) == 0);
+        assert(matches[i] == range.contains(id));
+        expected_count += range.contains(id);
+      }
+      assert(count == expected_count);
+    }
+  }
+
+  // IDs equal to the bounds and one less than them
+  TimeRange range = TimeRange::from_timestamps(T + 1, T + 2);
+  char records[4 * 26];
+  range.lower.encode(&records[0]);
+  Id::from_u128(range.lower.to_u128() - 1).encode(&records[26]);
+  range.upper.encode(&records[52]);
+  Id::from_u128(range.upper.to_u128() - 1).encode(&records[78]);
+  char lower[26], upper[26];
+  range.text_bounds(lower, upper);
+  uint8_t matches[4];
+  assert(filter_text(records, 4, lower, upper, matches) == 2);
+  assert(matches[0] == 1 && matches[1] == 0);
+  assert(matches[2] == 0 && matches[3] == 1);
+
+  // uppercase records compare as their lowercase equivalents
+  for (char &c : records) {
+    c = c >= 'a' && c <= 'z' ? (char)(c - 32) : c;
+  }
+  assert(filter_text(records, 4, lower, upper, matches) == 2);
+  assert(matches[0] == 1 && matches[3] == 1);
+}
+
+#ifdef RUN_BENCHMARKS
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Compares filtering with decoding and with `memcmp()` on 4 million IDs. */
+static void run_benchmarks(void) {
+  const size_t N = 4000000;
+  std::vector<char> texts = generate_texts(N, 1000);
+  TimeRange range = TimeRange::from_timestamps(T + 1000, T + 3000);
+  char lower[26], upper[26];
+  range.text_bounds(lower, upper);
+  std::vector<uint8_t> matches(N);
+
+  uint64_t start = now_ns();
+  size_t decoded = 0;
+  for (size_t i = 0; i < N; i++) {
+    Id id = {0, 0};
+    Id::decode(&texts[26 * i], &id);
+    matches[i] = range.contains(id);
+    decoded += matches[i];
+  }
+  double decode_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  size_t compared = 0;
+  for (size_t i = 0; i < N; i++) {
+    const char *text = &texts[26 * i];
+    matches[i] = memcmp(text, lower, 25) >= 0 && memcmp(text, upper, 25) < 0;
+    compared += matches[i];
+  }
+  double memcmp_ns = (double)(now_ns() - start) / N;
+
+  start = now_ns();
+  size_t filtered = filter_text(texts.data(), N, lower, upper, matches.data());
+  double filter_ns = (double)(now_ns() - start) / N;
+
+  assert(decoded == compared && compared == filtered);
+  printf("decode: %5.2f ns/id  memcmp: %5.2f ns/id  filter_text: %5.2f ns/id  "
+         "(%zu matches)\n",
+         decode_ns, memcmp_ns, filter_ns, filtered);
+}
+#endif /* #ifdef RUN_BENCHMARKS */
+
+int main(void) {
+  test_bounds();
+  test_filter_text();
+#ifdef RUN_BENCHMARKS
+  run_benchmarks();
+#endif
+  return 0;
+}